@@ -0,0 +1,305 @@
+/*
+ * Boot area backup store
+ * ----------------------
+ *
+ * Content-addressed store for the original 16-sector boot area of patched
+ * images, so they can be restored (unpatched) later with a single write.
+ *
+ * Layout:
+ *   <store>/objects/<hash>     original boot area, RLE compressed
+ *                              (identical boot areas are stored once)
+ *   <store>/refs/<id>_<size>_<hash>
+ *                              image identity -> object: Disc ID, image size
+ *                              and hash of the *patched* boot area, so a
+ *                              patched image finds its backup from its own
+ *                              boot area
+ *
+ * Hashes are 64-bit FNV-1a. Files are written to a temporary name and
+ * renamed, so concurrent batch workers never see partial files.
+ *
+ * The compression is a PackBits style RLE: boot areas are mostly zero
+ * fill, blank logo areas, space padding and repeated sector headers.
+ *
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#define BACKUP_MAGIC            "PS2MBAK1"
+#define BACKUP_DEFAULT_DIR      ".ps2master-backup"     // in $HOME
+#define BACKUP_ENV              "PS2MASTER_BACKUP"
+#define BACKUP_PATH_MAX         1024                    // store directory path
+#define BACKUP_NAME_MAX         64                      // path under the store (refs/<id>_<size>_<hash>)
+
+typedef struct {
+    char magic[8];
+    uint32_t size;              // uncompressed size
+    uint32_t packed_size;
+    uint64_t hash;              // hash of the uncompressed data
+} backup_header_t;
+
+// 64-bit FNV-1a
+static inline uint64_t backup_hash(const uint8_t *data, size_t size)
+{
+    uint64_t hash = 0xCBF29CE484222325ULL;
+
+    while (size--)
+        hash = (hash ^ *data++) * 0x100000001B3ULL;
+
+    return hash;
+}
+
+///////////////////////////////////////////////////////////
+// compresses data with PackBits RLE
+// (control byte n: 0-127 = n+1 literal bytes, 129-255 = byte repeated 257-n times)
+//
+// args:    out: output buffer (at least size + size/128 + 1 bytes)
+//          in: input data
+//          size: input size
+// returns: compressed size
+static inline size_t backup_pack(uint8_t *out, const uint8_t *in, size_t size)
+{
+    size_t i = 0, o = 0;
+
+    while (i < size)
+    {
+        size_t run = 1;
+
+        while (i + run < size && run < 128 && in[i + run] == in[i])
+            run++;
+
+        if (run > 2)
+        {
+            out[o++] = (uint8_t)(257 - run);
+            out[o++] = in[i];
+            i += run;
+            continue;
+        }
+
+        // literals, until the next run of 3+ bytes
+        size_t lit = 0;
+        while (i + lit < size && lit < 128 &&
+              !(i + lit + 2 < size && in[i + lit] == in[i + lit + 1] && in[i + lit] == in[i + lit + 2]))
+            lit++;
+
+        out[o++] = (uint8_t)(lit - 1);
+        memcpy(out + o, in + i, lit);
+        o += lit;
+        i += lit;
+    }
+
+    return o;
+}
+
+// Decompresses PackBits RLE data, returns false if the data is corrupt
+static inline bool backup_unpack(uint8_t *out, size_t size, const uint8_t *in, size_t packed)
+{
+    size_t i = 0, o = 0;
+
+    while (i < packed)
+    {
+        uint8_t n = in[i++];
+
+        if (n < 128)
+        {
+            if (i + n + 1 > packed || o + n + 1 > size)
+                return false;
+            memcpy(out + o, in + i, n + 1);
+            i += n + 1;
+            o += n + 1;
+        }
+        else if (n > 128)
+        {
+            if (i >= packed || o + 257 - n > size)
+                return false;
+            memset(out + o, in[i++], 257 - n);
+            o += 257 - n;
+        }
+        else
+            return false;
+    }
+
+    return (o == size);
+}
+
+// snprintf for store paths: false if the path doesn't fit
+__attribute__((format(printf, 3, 4)))
+static bool backup_path(char *path, size_t len, const char *fmt, ...)
+{
+    va_list ap;
+    int n;
+
+    va_start(ap, fmt);
+    n = vsnprintf(path, len, fmt, ap);
+    va_end(ap);
+
+    return (n >= 0 && (size_t)n < len);
+}
+
+// Gets the backup store directory ($PS2MASTER_BACKUP, or ~/.ps2master-backup),
+// false if the path is longer than BACKUP_PATH_MAX
+static inline bool backup_store_dir(char *path, size_t len)
+{
+    const char *env = getenv(BACKUP_ENV);
+    const char *home = getenv("HOME");
+
+    if (env && *env)
+        return backup_path(path, len, "%s", env);
+
+    return backup_path(path, len, "%s/%s", (home && *home) ? home : ".", BACKUP_DEFAULT_DIR);
+}
+
+static bool backup_mkdir(const char *path)
+{
+    return (mkdir(path, 0777) == 0 || errno == EEXIST);
+}
+
+static bool backup_ref_path(char *path, size_t len, const char *store, const char *disc_id, uint64_t image_size, uint64_t hash)
+{
+    return backup_path(path, len, "%s/refs/%s_%" PRIu64 "_%016" PRIx64, store, disc_id, image_size, hash);
+}
+
+// Writes a file through a temporary name + rename (atomic for concurrent writers)
+static bool backup_write_file(const char *path, const void *data1, size_t size1, const void *data2, size_t size2)
+{
+    char tmp[BACKUP_PATH_MAX + 2 * BACKUP_NAME_MAX];
+    FILE *fp;
+    bool ret;
+
+    if (!backup_path(tmp, sizeof(tmp), "%s.%d.%lx.tmp", path, (int)getpid(), (unsigned long)pthread_self()))
+        return false;
+
+    fp = fopen(tmp, "wb");
+    if (!fp)
+        return false;
+
+    ret = (fwrite(data1, 1, size1, fp) == size1 && fwrite(data2, 1, size2, fp) == size2);
+    ret = (fclose(fp) == 0 && ret);
+
+    if (ret && rename(tmp, path) == 0)
+        return true;
+
+    remove(tmp);
+    return false;
+}
+
+///////////////////////////////////////////////////////////
+// saves the original boot area of an image in the backup store
+//
+// args:    store: backup store directory
+//          disc_id: image Disc ID (eg SLUS-20946)
+//          image_size: image size in bytes
+//          original: original boot area
+//          patched: patched boot area (used to find the backup from the image later)
+//          size: boot area size
+//          object: placeholder for the object file path (optional)
+//          object_len: object placeholder size
+// returns: true  if ok
+//          false if error (or a path longer than the buffers)
+static inline bool backup_save(const char *store, const char *disc_id, uint64_t image_size,
+                 const uint8_t *original, const uint8_t *patched, size_t size, char *object, size_t object_len)
+{
+    char path[BACKUP_PATH_MAX + BACKUP_NAME_MAX], ref[32];
+    backup_header_t hdr;
+    struct stat st;
+    uint8_t *packed;
+    bool ret = true;
+
+    if (!backup_path(path, sizeof(path), "%s/objects", store) || !backup_mkdir(store) || !backup_mkdir(path))
+        return false;
+    if (!backup_path(path, sizeof(path), "%s/refs", store) || !backup_mkdir(path))
+        return false;
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, BACKUP_MAGIC, sizeof(hdr.magic));
+    hdr.size = size;
+    hdr.hash = backup_hash(original, size);
+
+    // object (skipped if the same boot area is already stored)
+    if (!backup_path(path, sizeof(path), "%s/objects/%016" PRIx64, store, hdr.hash) ||
+        (object && !backup_path(object, object_len, "%s", path)))
+        return false;
+
+    if (stat(path, &st) != 0)
+    {
+        packed = malloc(size + size / 128 + 1);
+        if (!packed)
+            return false;
+
+        hdr.packed_size = backup_pack(packed, original, size);
+        ret = backup_write_file(path, &hdr, sizeof(hdr), packed, hdr.packed_size);
+        free(packed);
+    }
+
+    // reference from the patched image identity
+    snprintf(ref, sizeof(ref), "%016" PRIx64 "\n", hdr.hash);
+    return (ret && backup_ref_path(path, sizeof(path), store, disc_id, image_size, backup_hash(patched, size)) &&
+            backup_write_file(path, ref, strlen(ref), "", 0));
+}
+
+///////////////////////////////////////////////////////////
+// loads the original boot area of a patched image from the backup store
+//
+// args:    store: backup store directory
+//          disc_id: image Disc ID (eg SLUS-20946)
+//          image_size: image size in bytes
+//          patched: current (patched) boot area
+//          out: placeholder for the original boot area
+//          size: boot area size
+// returns: true  if ok
+//          false if no backup was found or it is corrupt
+static inline bool backup_load(const char *store, const char *disc_id, uint64_t image_size, const uint8_t *patched, uint8_t *out, size_t size)
+{
+    char path[BACKUP_PATH_MAX + BACKUP_NAME_MAX], ref[32] = "";
+    backup_header_t hdr;
+    uint8_t *packed;
+    FILE *fp;
+    bool ret;
+
+    if (!backup_ref_path(path, sizeof(path), store, disc_id, image_size, backup_hash(patched, size)))
+        return false;
+
+    fp = fopen(path, "r");
+    if (!fp)
+        return false;
+
+    ret = (fgets(ref, sizeof(ref), fp) != NULL);
+    fclose(fp);
+
+    // the object hash: exactly 16 lowercase hex digits (it becomes a path)
+    if (!ret || strspn(ref, "0123456789abcdef") != 16 || (ref[16] && ref[16] != '\n'))
+        return false;
+
+    ref[16] = 0;
+    if (!backup_path(path, sizeof(path), "%s/objects/%s", store, ref))
+        return false;
+
+    fp = fopen(path, "rb");
+    if (!fp)
+        return false;
+
+    if (fread(&hdr, sizeof(hdr), 1, fp) != 1 || memcmp(hdr.magic, BACKUP_MAGIC, sizeof(hdr.magic)) != 0 ||
+        hdr.size != size || hdr.packed_size > size + size / 128 + 1)
+    {
+        fclose(fp);
+        return false;
+    }
+
+    packed = malloc(hdr.packed_size);
+    ret = (packed && fread(packed, 1, hdr.packed_size, fp) == hdr.packed_size);
+    fclose(fp);
+
+    ret = (ret && backup_unpack(out, size, packed, hdr.packed_size) && backup_hash(out, size) == hdr.hash);
+    free(packed);
+
+    return ret;
+}
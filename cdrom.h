@@ -39,7 +39,7 @@
 #define CDROMXA_FORM1_PARITY_Q_SIZE    (26 * 2 * 2)
 
 //The following table is used for computing the error detection code (EDC)
-unsigned int EDCTable[256] =
+static const unsigned int EDCTable[256] =
 {
     /*          0           1           2           3           4           5           6           7           8           9           A           B           C           D           E           F            */
     /* 0 */ 0x00000000, 0x90910101, 0x91210201, 0x01B00300, 0x92410401, 0x02D00500, 0x03600600, 0x93F10701, 0x94810801, 0x04100900, 0x05A00A00, 0x95310B01, 0x06C00C00, 0x96510D01, 0x97E10E01, 0x07700F00, /* 0 */
@@ -62,7 +62,7 @@ unsigned int EDCTable[256] =
 };
 
 //The following table is used for computing the error correction code (ECC)
-unsigned short RSPCTable[43][256] =
+static const unsigned short RSPCTable[43][256] =
 {
     /*          00      01      02      03      04      05      06      07      08      09      0A      0B      0C      0D      0E      0F      10      11      12      13      14      15      16      17      18      19      1A      1B      1C      1D      1E      1F      20      21      22      23      24      25      26      27      28      29      2A      2B      2C      2D      2E      2F      30      31      32      33      34      35      36      37      38      39      3A      3B      3C      3D      3E      3F      40      41      42      43      44      45      46      47      48      49      4A      4B      4C      4D      4E      4F      50      51      52      53      54      55      56      57      58      59      5A      5B      5C      5D      5E      5F      60      61      62      63      64      65      66      67      68      69      6A      6B      6C      6D      6E      6F      70      71      72      73      74      75      76      77      78      79      7A      7B      7C      7D      7E      7F      80      81      82      83      84      85      86      87      88      89      8A      8B      8C      8D      8E      8F      90      91      92      93      94      95      96      97      98      99      9A      9B      9C      9D      9E      9F      A0      A1      A2      A3      A4      A5      A6      A7      A8      A9      AA      AB      AC      AD      AE      AF      B0      B1      B2      B3      B4      B5      B6      B7      B8      B9      BA      BB      BC      BD      BE      BF      C0      C1      C2      C3      C4      C5      C6      C7      C8      C9      CA      CB      CC      CD      CE      CF      D0      D1      D2      D3      D4      D5      D6      D7      D8      D9      DA      DB      DC      DD      DE      DF      E0      E1      E2      E3      E4      E5      E6      E7      E8      E9      EA      EB      EC      ED      EE      EF      F0      F1      F2      F3      F4      F5      F6      F7      F8      F9      FA      FB      FC      FD      FE      FF           */
     /* 00 */ {0x0000, 0xAEAF, 0x4143, 0xEFEC, 0x8286, 0x2C29, 0xC3C5, 0x6D6A, 0x1911, 0xB7BE, 0x5852, 0xF6FD, 0x9B97, 0x3538, 0xDAD4, 0x747B, 0x3222, 0x9C8D, 0x7361, 0xDDCE, 0xB0A4, 0x1E0B, 0xF1E7, 0x5F48, 0x2B33, 0x859C, 0x6A70, 0xC4DF, 0xA9B5, 0x071A, 0xE8F6, 0x4659, 0x6444, 0xCAEB, 0x2507, 0x8BA8, 0xE6C2, 0x486D, 0xA781, 0x092E, 0x7D55, 0xD3FA, 0x3C16, 0x92B9, 0xFFD3, 0x517C, 0xBE90, 0x103F, 0x5666, 0xF8C9, 0x1725, 0xB98A, 0xD4E0, 0x7A4F, 0x95A3, 0x3B0C, 0x4F77, 0xE1D8, 0x0E34, 0xA09B, 0xCDF1, 0x635E, 0x8CB2, 0x221D, 0xC888, 0x6627, 0x89CB, 0x2764, 0x4A0E, 0xE4A1, 0x0B4D, 0xA5E2, 0xD199, 0x7F36, 0x90DA, 0x3E75, 0x531F, 0xFDB0, 0x125C, 0xBCF3, 0xFAAA, 0x5405, 0xBBE9, 0x1546, 0x782C, 0xD683, 0x396F, 0x97C0, 0xE3BB, 0x4D14, 0xA2F8, 0x0C57, 0x613D, 0xCF92, 0x207E, 0x8ED1, 0xACCC, 0x0263, 0xED8F, 0x4320, 0x2E4A, 0x80E5, 0x6F09, 0xC1A6, 0xB5DD, 0x1B72, 0xF49E, 0x5A31, 0x375B, 0x99F4, 0x7618, 0xD8B7, 0x9EEE, 0x3041, 0xDFAD, 0x7102, 0x1C68, 0xB2C7, 0x5D2B, 0xF384, 0x87FF, 0x2950, 0xC6BC, 0x6813, 0x0579, 0xABD6, 0x443A, 0xEA95, 0x8D0D, 0x23A2, 0xCC4E, 0x62E1, 0x0F8B, 0xA124, 0x4EC8, 0xE067, 0x941C, 0x3AB3, 0xD55F, 0x7BF0, 0x169A, 0xB835, 0x57D9, 0xF976, 0xBF2F, 0x1180, 0xFE6C, 0x50C3, 0x3DA9, 0x9306, 0x7CEA, 0xD245, 0xA63E, 0x0891, 0xE77D, 0x49D2, 0x24B8, 0x8A17, 0x65FB, 0xCB54, 0xE949, 0x47E6, 0xA80A, 0x06A5, 0x6BCF, 0xC560, 0x2A8C, 0x8423, 0xF058, 0x5EF7, 0xB11B, 0x1FB4, 0x72DE, 0xDC71, 0x339D, 0x9D32, 0xDB6B, 0x75C4, 0x9A28, 0x3487, 0x59ED, 0xF742, 0x18AE, 0xB601, 0xC27A, 0x6CD5, 0x8339, 0x2D96, 0x40FC, 0xEE53, 0x01BF, 0xAF10, 0x4585, 0xEB2A, 0x04C6, 0xAA69, 0xC703, 0x69AC, 0x8640, 0x28EF, 0x5C94, 0xF23B, 0x1DD7, 0xB378, 0xDE12, 0x70BD, 0x9F51, 0x31FE, 0x77A7, 0xD908, 0x36E4, 0x984B, 0xF521, 0x5B8E, 0xB462, 0x1ACD, 0x6EB6, 0xC019, 0x2FF5, 0x815A, 0xEC30, 0x429F, 0xAD73, 0x03DC, 0x21C1, 0x8F6E, 0x6082, 0xCE2D, 0xA347, 0x0DE8, 0xE204, 0x4CAB, 0x38D0, 0x967F, 0x7993, 0xD73C, 0xBA56, 0x14F9, 0xFB15, 0x55BA, 0x13E3, 0xBD4C, 0x52A0, 0xFC0F, 0x9165, 0x3FCA, 0xD026, 0x7E89, 0x0AF2, 0xA45D, 0x4BB1, 0xE51E, 0x8874, 0x26DB, 0xC937, 0x6798}, /* 00 */
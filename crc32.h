@@ -0,0 +1,252 @@
+/*
+ * CRC-32 (IEEE 802.3, reflected polynomial 0xEDB88320)
+ * ----------------------------------------------------
+ *
+ * Streaming CRC-32 engine with a slice-by-16 table kernel and a PCLMULQDQ
+ * folding kernel (x86), selected at runtime through CPU dispatch.
+ * The folding kernel is generic and is shared with other reflected 32-bit
+ * CRCs (CD-ROM EDC, see edc.h).
+ *
+ * The folding constants and Barrett reduction are taken from the Intel paper
+ * "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction"
+ * (bit-reflected domain constants given at the end of the paper).
+ *
+ * Usage:
+ *     crc32_ctx ctx;
+ *     crc32_init(&ctx);
+ *     crc32_update(&ctx, data, size);
+ *     crc = crc32_final(&ctx);
+ *
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CRC32_HAVE_CLMUL
+#endif
+
+#define CRC32_POLY          0xEDB88320
+#define CRC32_CLMUL_MIN     64      // minimum length for the folding kernel
+
+typedef struct {
+    uint32_t crc;
+} crc32_ctx;
+
+typedef uint32_t (*crc32_kernel_t)(uint32_t crc, const uint8_t *data, size_t size);
+
+static uint32_t crc32_table[16][256];
+static crc32_kernel_t crc32_kernel;
+static pthread_once_t crc32_once = PTHREAD_ONCE_INIT;
+
+static uint32_t crc32_load_le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Byte-wise table kernel (also used for the head/tail of the other kernels)
+static uint32_t crc32_bytewise(uint32_t crc, const uint8_t *data, size_t size)
+{
+    while (size--)
+        crc = (crc >> 8) ^ crc32_table[0][(crc ^ *data++) & 0xFF];
+
+    return crc;
+}
+
+// Slice-by-16 table kernel: 16 independent lookups per 16 input bytes
+static uint32_t crc32_slice16(uint32_t crc, const uint8_t *data, size_t size)
+{
+    while (size >= 16)
+    {
+        uint32_t a = crc32_load_le32(data +  0) ^ crc;
+        uint32_t b = crc32_load_le32(data +  4);
+        uint32_t c = crc32_load_le32(data +  8);
+        uint32_t d = crc32_load_le32(data + 12);
+
+        crc = crc32_table[15][ a        & 0xFF] ^ crc32_table[14][(a >>  8) & 0xFF] ^
+              crc32_table[13][(a >> 16) & 0xFF] ^ crc32_table[12][ a >> 24        ] ^
+              crc32_table[11][ b        & 0xFF] ^ crc32_table[10][(b >>  8) & 0xFF] ^
+              crc32_table[ 9][(b >> 16) & 0xFF] ^ crc32_table[ 8][ b >> 24        ] ^
+              crc32_table[ 7][ c        & 0xFF] ^ crc32_table[ 6][(c >>  8) & 0xFF] ^
+              crc32_table[ 5][(c >> 16) & 0xFF] ^ crc32_table[ 4][ c >> 24        ] ^
+              crc32_table[ 3][ d        & 0xFF] ^ crc32_table[ 2][(d >>  8) & 0xFF] ^
+              crc32_table[ 1][(d >> 16) & 0xFF] ^ crc32_table[ 0][ d >> 24        ];
+
+        data += 16;
+        size -= 16;
+    }
+
+    return crc32_bytewise(crc, data, size);
+}
+
+#ifdef CRC32_HAVE_CLMUL
+// Folding constants for a reflected 32-bit CRC polynomial P(x):
+//   k1 = x^(4*128+32) mod P, k2 = x^(4*128-32) mod P (4x128-bit fold)
+//   k3 = x^(128+32) mod P,   k4 = x^(128-32) mod P   (1x128-bit fold)
+//   k5 = x^64 mod P, plus P and mu = x^64 div P for the Barrett reduction
+// (bit-reflected, see the Intel paper)
+typedef struct {
+    uint64_t k1k2[2];
+    uint64_t k3k4[2];
+    uint64_t k5k0[2];
+    uint64_t poly[2];
+} __attribute__((aligned(16))) crc_clmul_consts_t;
+
+static const crc_clmul_consts_t crc32_clmul_consts = {
+    { 0x0154442bd4, 0x01c6e41596 },
+    { 0x01751997d0, 0x00ccaa009e },
+    { 0x0163cd6124, 0x0000000000 },
+    { 0x01db710641, 0x01f7011641 },
+};
+
+///////////////////////////////////////////////////////////
+// PCLMULQDQ folding kernel for reflected 32-bit CRCs
+// folds 4x128 bits per iteration, then Barrett-reduces to 32 bits
+//
+// args:    crc: current CRC register
+//          data: input data
+//          size: input size (only whole 16-byte blocks are processed, size >= 64)
+//          k: polynomial folding constants
+// returns: updated CRC register (the caller processes the last size % 16 bytes)
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t crc_clmul_fold(uint32_t crc, const uint8_t *data, size_t size, const crc_clmul_consts_t *k)
+{
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8;
+
+    x1 = _mm_loadu_si128((const __m128i *)(data + 0x00));
+    x2 = _mm_loadu_si128((const __m128i *)(data + 0x10));
+    x3 = _mm_loadu_si128((const __m128i *)(data + 0x20));
+    x4 = _mm_loadu_si128((const __m128i *)(data + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(crc));
+    x0 = _mm_load_si128((const __m128i *)k->k1k2);
+    data += 64;
+    size -= 64;
+
+    // Parallel fold blocks of 64 bytes
+    while (size >= 64)
+    {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i *)(data + 0x00)));
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i *)(data + 0x10)));
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i *)(data + 0x20)));
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i *)(data + 0x30)));
+        data += 64;
+        size -= 64;
+    }
+
+    // Fold into 128 bits
+    x0 = _mm_load_si128((const __m128i *)k->k3k4);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    // Single fold blocks of 16 bytes
+    while (size >= 16)
+    {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, _mm_loadu_si128((const __m128i *)data)), x5);
+        data += 16;
+        size -= 16;
+    }
+
+    // Fold 128 bits to 64 bits
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+    x0 = _mm_loadl_epi64((const __m128i *)k->k5k0);
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    // Barrett reduce to 32 bits
+    x0 = _mm_load_si128((const __m128i *)k->poly);
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    return (uint32_t)_mm_extract_epi32(x1, 1);
+}
+
+static uint32_t crc32_clmul(uint32_t crc, const uint8_t *data, size_t size)
+{
+    if (size < CRC32_CLMUL_MIN)
+        return crc32_slice16(crc, data, size);
+
+    crc = crc_clmul_fold(crc, data, size, &crc32_clmul_consts);
+
+    // Remaining bytes (< 16)
+    return crc32_slice16(crc, data + (size & ~(size_t)15), size & 15);
+}
+#endif
+
+// Build the slice-by-16 tables and pick the fastest kernel for this CPU
+static void crc32_setup(void)
+{
+    for (int i = 0; i < 256; i++)
+    {
+        uint32_t crc = i;
+
+        for (int j = 0; j < 8; j++)
+            crc = (crc >> 1) ^ (CRC32_POLY & -(crc & 1));
+
+        crc32_table[0][i] = crc;
+    }
+
+    for (int i = 0; i < 256; i++)
+        for (int t = 1; t < 16; t++)
+            crc32_table[t][i] = (crc32_table[t - 1][i] >> 8) ^ crc32_table[0][crc32_table[t - 1][i] & 0xFF];
+
+    crc32_kernel = crc32_slice16;
+
+#ifdef CRC32_HAVE_CLMUL
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1"))
+        crc32_kernel = crc32_clmul;
+#endif
+}
+
+static inline void crc32_init(crc32_ctx *ctx)
+{
+    pthread_once(&crc32_once, crc32_setup);
+    ctx->crc = 0xFFFFFFFF;
+}
+
+static inline void crc32_update(crc32_ctx *ctx, const void *data, size_t size)
+{
+    ctx->crc = crc32_kernel(ctx->crc, data, size);
+}
+
+static inline uint32_t crc32_final(const crc32_ctx *ctx)
+{
+    return ~ctx->crc;
+}
+
+// One-shot CRC-32 of a memory buffer
+static inline uint32_t crc32_calc(const void *data, size_t size)
+{
+    crc32_ctx ctx;
+
+    crc32_init(&ctx);
+    crc32_update(&ctx, data, size);
+    return crc32_final(&ctx);
+}
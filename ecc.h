@@ -0,0 +1,342 @@
+/*
+ * CD-ROM ECC (Reed-Solomon Product Code) P/Q parity generation
+ * ------------------------------------------------------------
+ *
+ * The 2236 bytes from the header (0x0C) to the end of the P parity (0x8C7)
+ * are seen as a 26 x 43 matrix of 16-bit words, processed as two independent
+ * byte planes (LSB/MSB):
+ *   P parity: 43 columns (24 rows each, coefficients RSPCTable[19..42])
+ *   Q parity: 26 diagonals (43 words each, coefficients RSPCTable[0..42])
+ *
+ * Every RSPCTable entry is a GF(2^8) multiplication by a constant (high byte
+ * for the first parity byte, low byte for the second one), which is linear,
+ * so it can be done with SIMD:
+ *   SSSE3/AVX2: two 16-entry nibble tables and PSHUFB per constant
+ *   GFNI:       one 8x8 bit matrix and GF2P8AFFINEQB per constant
+ *
+ * P columns are contiguous 86-byte rows, so 86 columns are computed at once.
+ * Q diagonals are gathered first (precomputed offsets), then 52 lanes are
+ * computed at once. The scalar PSXtract loop is kept as reference/fallback.
+ *
+ * The Mode 2 header must be cleared by the caller before computing P/Q.
+ *
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ECC_HAVE_SIMD
+#endif
+
+#define ECC_P_ROWS          24
+#define ECC_P_COLS          (43 * 2)
+#define ECC_Q_DIAGS         (26 * 2)
+#define ECC_Q_WORDS         43
+#define ECC_PQ_AREA         (CDROMXA_FORM1_PARITY_Q_OFFSET - HEADER_OFFSET)    // 2236 bytes
+
+typedef void (*ecc_kernel_t)(uint8_t *sector);
+
+static uint8_t ecc_nibble[43][2][2][16];    // [coefficient][parity byte][low/high nibble]
+static uint64_t ecc_matrix[43][2];          // [coefficient][parity byte] GF(2) 8x8 matrices
+static uint16_t ecc_q_index[ECC_Q_WORDS][ECC_Q_DIAGS / 2];
+static ecc_kernel_t ecc_kernel;
+static pthread_once_t ecc_once = PTHREAD_ONCE_INIT;
+
+// Reference implementation (PSXtract)
+static void ecc_pq_scalar(uint8_t *sector)
+{
+    //Calculate P parity
+    unsigned char* src = sector + HEADER_OFFSET;
+    unsigned char* dst = sector + CDROMXA_FORM1_PARITY_P_OFFSET;
+    for(int i = 0; i < 43; ++i)
+    {
+        unsigned short x = 0x0000;
+        unsigned short y = 0x0000;
+        for(int j = 19; j < 43; ++j)
+        {
+            x ^= RSPCTable[j][src[0]]; //LSB
+            y ^= RSPCTable[j][src[1]]; //MSB
+            src += 2 * 43;
+        }
+        dst[         0] = x >> 8;
+        dst[2 * 43 + 0] = x & 0xFF;
+        dst[         1] = y >> 8;
+        dst[2 * 43 + 1] = y & 0xFF;
+        dst += 2;
+        src -= (43 - 19) * 2 * 43; //Restore src to the state before the inner loop
+        src += 2;
+    }
+
+    //Calculate Q parity
+    src = sector + HEADER_OFFSET;
+    dst = sector + CDROMXA_FORM1_PARITY_Q_OFFSET;
+    unsigned char* src_end = sector + CDROMXA_FORM1_PARITY_Q_OFFSET;
+    for(int i = 0; i < 26; ++i)
+    {
+        unsigned char* src_backup = src;
+        unsigned short x = 0x0000;
+        unsigned short y = 0x0000;
+        for(int j = 0; j < 43; ++j)
+        {
+            x ^= RSPCTable[j][src[0]]; //LSB
+            y ^= RSPCTable[j][src[1]]; //MSB
+            src += 2 * 44;
+            if(src >= src_end)
+            {
+                src = src - (HEADER_SIZE + CDROMXA_SUBHEADER_SIZE + CDROMXA_FORM1_USER_DATA_SIZE + EDC_SIZE + CDROMXA_FORM1_PARITY_P_SIZE);
+            }
+        }
+
+        dst[         0] = x >> 8;
+        dst[2 * 26 + 0] = x & 0xFF;
+        dst[         1] = y >> 8;
+        dst[2 * 26 + 1] = y & 0xFF;
+        dst += 2;
+        src = src_backup;
+        src += 2 * 43;
+    }
+}
+
+#ifdef ECC_HAVE_SIMD
+// Gather the 43 words of every Q diagonal, one 64-byte row per coefficient (52 lanes used)
+static void ecc_q_gather(const uint8_t *sector, uint8_t q_in[ECC_Q_WORDS][64])
+{
+    for (int j = 0; j < ECC_Q_WORDS; j++)
+    {
+        for (int i = 0; i < ECC_Q_DIAGS / 2; i++)
+            memcpy(&q_in[j][2 * i], sector + ecc_q_index[j][i], 2);
+
+        memset(&q_in[j][ECC_Q_DIAGS], 0, 64 - ECC_Q_DIAGS);
+    }
+}
+
+// GF(2^8) multiply by constant: PSHUFB on the low and high nibbles
+#define ECC_MUL_SSSE3(v, t) \
+    _mm_xor_si128(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(t)[0]), _mm_and_si128((v), nib)), \
+                  _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(t)[1]), _mm_and_si128(_mm_srli_epi16((v), 4), nib)))
+
+__attribute__((target("ssse3")))
+static void ecc_pq_ssse3(uint8_t *sector)
+{
+    const __m128i nib = _mm_set1_epi8(0x0F);
+    uint8_t q_in[ECC_Q_WORDS][64] __attribute__((aligned(16)));
+    uint8_t out[2][96] __attribute__((aligned(16)));
+    __m128i p0[6], p1[6];
+
+    // P parity: 86 columns at once (6 x 16 lanes, the last 10 are discarded)
+    for (int k = 0; k < 6; k++)
+        p0[k] = p1[k] = _mm_setzero_si128();
+
+    for (int r = 0; r < ECC_P_ROWS; r++)
+    {
+        const uint8_t *row = sector + HEADER_OFFSET + r * ECC_P_COLS;
+
+        for (int k = 0; k < 6; k++)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i *)(row + k * 16));
+            p0[k] = _mm_xor_si128(p0[k], ECC_MUL_SSSE3(v, ecc_nibble[19 + r][0]));
+            p1[k] = _mm_xor_si128(p1[k], ECC_MUL_SSSE3(v, ecc_nibble[19 + r][1]));
+        }
+    }
+
+    for (int k = 0; k < 6; k++)
+    {
+        _mm_store_si128((__m128i *)(out[0] + k * 16), p0[k]);
+        _mm_store_si128((__m128i *)(out[1] + k * 16), p1[k]);
+    }
+    memcpy(sector + CDROMXA_FORM1_PARITY_P_OFFSET, out[0], ECC_P_COLS);
+    memcpy(sector + CDROMXA_FORM1_PARITY_P_OFFSET + ECC_P_COLS, out[1], ECC_P_COLS);
+
+    // Q parity: 52 diagonals at once (4 x 16 lanes)
+    ecc_q_gather(sector, q_in);
+    for (int k = 0; k < 4; k++)
+        p0[k] = p1[k] = _mm_setzero_si128();
+
+    for (int j = 0; j < ECC_Q_WORDS; j++)
+        for (int k = 0; k < 4; k++)
+        {
+            __m128i v = _mm_load_si128((const __m128i *)(q_in[j] + k * 16));
+            p0[k] = _mm_xor_si128(p0[k], ECC_MUL_SSSE3(v, ecc_nibble[j][0]));
+            p1[k] = _mm_xor_si128(p1[k], ECC_MUL_SSSE3(v, ecc_nibble[j][1]));
+        }
+
+    for (int k = 0; k < 4; k++)
+    {
+        _mm_store_si128((__m128i *)(out[0] + k * 16), p0[k]);
+        _mm_store_si128((__m128i *)(out[1] + k * 16), p1[k]);
+    }
+    memcpy(sector + CDROMXA_FORM1_PARITY_Q_OFFSET, out[0], ECC_Q_DIAGS);
+    memcpy(sector + CDROMXA_FORM1_PARITY_Q_OFFSET + ECC_Q_DIAGS, out[1], ECC_Q_DIAGS);
+}
+
+#define ECC_MUL_AVX2(v, t) \
+    _mm256_xor_si256(_mm256_shuffle_epi8(_mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)(t)[0])), _mm256_and_si256((v), nib)), \
+                     _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)(t)[1])), _mm256_and_si256(_mm256_srli_epi16((v), 4), nib)))
+
+__attribute__((target("avx2")))
+static void ecc_pq_avx2(uint8_t *sector)
+{
+    const __m256i nib = _mm256_set1_epi8(0x0F);
+    uint8_t q_in[ECC_Q_WORDS][64] __attribute__((aligned(32)));
+    uint8_t out[2][96] __attribute__((aligned(32)));
+    __m256i p0[3], p1[3];
+
+    // P parity: 86 columns at once (3 x 32 lanes, the last 10 are discarded)
+    for (int k = 0; k < 3; k++)
+        p0[k] = p1[k] = _mm256_setzero_si256();
+
+    for (int r = 0; r < ECC_P_ROWS; r++)
+    {
+        const uint8_t *row = sector + HEADER_OFFSET + r * ECC_P_COLS;
+
+        for (int k = 0; k < 3; k++)
+        {
+            __m256i v = _mm256_loadu_si256((const __m256i *)(row + k * 32));
+            p0[k] = _mm256_xor_si256(p0[k], ECC_MUL_AVX2(v, ecc_nibble[19 + r][0]));
+            p1[k] = _mm256_xor_si256(p1[k], ECC_MUL_AVX2(v, ecc_nibble[19 + r][1]));
+        }
+    }
+
+    for (int k = 0; k < 3; k++)
+    {
+        _mm256_store_si256((__m256i *)(out[0] + k * 32), p0[k]);
+        _mm256_store_si256((__m256i *)(out[1] + k * 32), p1[k]);
+    }
+    memcpy(sector + CDROMXA_FORM1_PARITY_P_OFFSET, out[0], ECC_P_COLS);
+    memcpy(sector + CDROMXA_FORM1_PARITY_P_OFFSET + ECC_P_COLS, out[1], ECC_P_COLS);
+
+    // Q parity: 52 diagonals at once (2 x 32 lanes)
+    ecc_q_gather(sector, q_in);
+    for (int k = 0; k < 2; k++)
+        p0[k] = p1[k] = _mm256_setzero_si256();
+
+    for (int j = 0; j < ECC_Q_WORDS; j++)
+        for (int k = 0; k < 2; k++)
+        {
+            __m256i v = _mm256_load_si256((const __m256i *)(q_in[j] + k * 32));
+            p0[k] = _mm256_xor_si256(p0[k], ECC_MUL_AVX2(v, ecc_nibble[j][0]));
+            p1[k] = _mm256_xor_si256(p1[k], ECC_MUL_AVX2(v, ecc_nibble[j][1]));
+        }
+
+    for (int k = 0; k < 2; k++)
+    {
+        _mm256_store_si256((__m256i *)(out[0] + k * 32), p0[k]);
+        _mm256_store_si256((__m256i *)(out[1] + k * 32), p1[k]);
+    }
+    memcpy(sector + CDROMXA_FORM1_PARITY_Q_OFFSET, out[0], ECC_Q_DIAGS);
+    memcpy(sector + CDROMXA_FORM1_PARITY_Q_OFFSET + ECC_Q_DIAGS, out[1], ECC_Q_DIAGS);
+}
+
+// GF(2^8) multiply by constant: one affine transform with the constant's bit matrix
+#define ECC_MUL_GFNI(v, m) \
+    _mm256_gf2p8affine_epi64_epi8((v), _mm256_set1_epi64x((long long)(m)), 0)
+
+__attribute__((target("avx2,gfni")))
+static void ecc_pq_gfni(uint8_t *sector)
+{
+    uint8_t q_in[ECC_Q_WORDS][64] __attribute__((aligned(32)));
+    uint8_t out[2][96] __attribute__((aligned(32)));
+    __m256i p0[3], p1[3];
+
+    // P parity: 86 columns at once (3 x 32 lanes, the last 10 are discarded)
+    for (int k = 0; k < 3; k++)
+        p0[k] = p1[k] = _mm256_setzero_si256();
+
+    for (int r = 0; r < ECC_P_ROWS; r++)
+    {
+        const uint8_t *row = sector + HEADER_OFFSET + r * ECC_P_COLS;
+
+        for (int k = 0; k < 3; k++)
+        {
+            __m256i v = _mm256_loadu_si256((const __m256i *)(row + k * 32));
+            p0[k] = _mm256_xor_si256(p0[k], ECC_MUL_GFNI(v, ecc_matrix[19 + r][0]));
+            p1[k] = _mm256_xor_si256(p1[k], ECC_MUL_GFNI(v, ecc_matrix[19 + r][1]));
+        }
+    }
+
+    for (int k = 0; k < 3; k++)
+    {
+        _mm256_store_si256((__m256i *)(out[0] + k * 32), p0[k]);
+        _mm256_store_si256((__m256i *)(out[1] + k * 32), p1[k]);
+    }
+    memcpy(sector + CDROMXA_FORM1_PARITY_P_OFFSET, out[0], ECC_P_COLS);
+    memcpy(sector + CDROMXA_FORM1_PARITY_P_OFFSET + ECC_P_COLS, out[1], ECC_P_COLS);
+
+    // Q parity: 52 diagonals at once (2 x 32 lanes)
+    ecc_q_gather(sector, q_in);
+    for (int k = 0; k < 2; k++)
+        p0[k] = p1[k] = _mm256_setzero_si256();
+
+    for (int j = 0; j < ECC_Q_WORDS; j++)
+        for (int k = 0; k < 2; k++)
+        {
+            __m256i v = _mm256_load_si256((const __m256i *)(q_in[j] + k * 32));
+            p0[k] = _mm256_xor_si256(p0[k], ECC_MUL_GFNI(v, ecc_matrix[j][0]));
+            p1[k] = _mm256_xor_si256(p1[k], ECC_MUL_GFNI(v, ecc_matrix[j][1]));
+        }
+
+    for (int k = 0; k < 2; k++)
+    {
+        _mm256_store_si256((__m256i *)(out[0] + k * 32), p0[k]);
+        _mm256_store_si256((__m256i *)(out[1] + k * 32), p1[k]);
+    }
+    memcpy(sector + CDROMXA_FORM1_PARITY_Q_OFFSET, out[0], ECC_Q_DIAGS);
+    memcpy(sector + CDROMXA_FORM1_PARITY_Q_OFFSET + ECC_Q_DIAGS, out[1], ECC_Q_DIAGS);
+}
+#endif
+
+// Build the GF(2^8) multiply tables from RSPCTable and pick the fastest kernel for this CPU
+static void ecc_setup(void)
+{
+    for (int j = 0; j < 43; j++)
+        for (int b = 0; b < 2; b++)
+        {
+            // parity byte 0 is the high byte of the table entry, byte 1 the low byte
+            int shift = b ? 0 : 8;
+
+            for (int n = 0; n < 16; n++)
+            {
+                ecc_nibble[j][b][0][n] = (RSPCTable[j][n] >> shift) & 0xFF;
+                ecc_nibble[j][b][1][n] = (RSPCTable[j][n << 4] >> shift) & 0xFF;
+            }
+
+            // affine matrix: byte (7 - i) holds the input bits that produce output bit i
+            ecc_matrix[j][b] = 0;
+            for (int i = 0; i < 8; i++)
+                for (int k = 0; k < 8; k++)
+                    if ((RSPCTable[j][1 << k] >> (shift + i)) & 1)
+                        ecc_matrix[j][b] |= (uint64_t)1 << ((7 - i) * 8 + k);
+        }
+
+    // Q diagonal i reads word (43*i + 44*j) mod (26*43) for coefficient j
+    for (int j = 0; j < ECC_Q_WORDS; j++)
+        for (int i = 0; i < ECC_Q_DIAGS / 2; i++)
+            ecc_q_index[j][i] = HEADER_OFFSET + ((ECC_P_COLS * i + 2 * 44 * j) % ECC_PQ_AREA);
+
+    ecc_kernel = ecc_pq_scalar;
+
+#ifdef ECC_HAVE_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("gfni") && __builtin_cpu_supports("avx2"))
+        ecc_kernel = ecc_pq_gfni;
+    else if (__builtin_cpu_supports("avx2"))
+        ecc_kernel = ecc_pq_avx2;
+    else if (__builtin_cpu_supports("ssse3"))
+        ecc_kernel = ecc_pq_ssse3;
+#endif
+}
+
+///////////////////////////////////////////////////////////
+// computes the P and Q parity of a CD-ROM sector
+//
+// args:    sector: raw 2352-byte sector (header cleared for Mode 2)
+//                  P parity is written at 0x81C, Q parity at 0x8C8
+static inline void ecc_compute_pq(uint8_t *sector)
+{
+    pthread_once(&ecc_once, ecc_setup);
+    ecc_kernel(sector);
+}
@@ -0,0 +1,107 @@
+/*
+ * Compact CD image container (ECM style)
+ * --------------------------------------
+ *
+ * Raw CD images are stored without the fields that libps2master regenerates
+ * bit-exact (sync, header, second subheader copy, EDC, reserved bytes and P/Q
+ * parity, about 13% of a Form 1 sector), see ps2m_sectors_reduce().
+ *
+ * Layout:
+ *   ecm_header_t               image geometry and size
+ *   chunks                     ECM_CHUNK_SECTORS sectors each (the last one may be shorter):
+ *     ecm_chunk_t              sizes and hash of the image sectors
+ *     runs                     record type of every sector, run-length coded:
+ *                              1 byte type (PS2M_REDUCED_*) + 4 bytes count (little endian)
+ *     records                  ps2m_sectors_reduce() records (sectors that don't
+ *                              rebuild bit-exact are stored as is)
+ *
+ * Chunks are independent, so they are reduced and rebuilt in parallel. The
+ * hash is the 64-bit FNV-1a of the original image sectors (backup_hash, see
+ * backup.h), checked after rebuilding.
+ *
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#define ECM_MAGIC               "PS2MECM1"
+#define ECM_CHUNK_SECTORS       1024
+#define ECM_RUN_SIZE            5
+#define ECM_RUNS_MAX            (ECM_CHUNK_SECTORS * ECM_RUN_SIZE)
+
+typedef struct {
+    char magic[8];
+    uint32_t sector_size;       // image sector size (2336/2352/2448)
+    uint32_t chunk_sectors;     // sectors per chunk (ECM_CHUNK_SECTORS)
+    uint64_t image_size;        // image size in bytes (whole sectors)
+    uint32_t num_chunks;
+    uint32_t reserved;
+} ecm_header_t;
+
+typedef struct {
+    uint32_t count;             // sectors in the chunk
+    uint32_t runs_size;
+    uint32_t records_size;
+    uint32_t reserved;
+    uint64_t hash;              // hash of the image sectors
+} ecm_chunk_t;
+
+///////////////////////////////////////////////////////////
+// run-length codes the record types of a chunk
+//
+// args:    out: placeholder for the runs (up to count * ECM_RUN_SIZE bytes)
+//          types: record type of every sector
+//          count: number of sectors
+// returns: runs size
+static inline size_t ecm_pack_types(uint8_t *out, const uint8_t *types, uint32_t count)
+{
+    size_t o = 0;
+
+    for (uint32_t i = 0; i < count; )
+    {
+        uint32_t run = 1;
+
+        while (i + run < count && types[i + run] == types[i])
+            run++;
+
+        out[o + 0] = types[i];
+        out[o + 1] = (run >>  0) & 0xFF;
+        out[o + 2] = (run >>  8) & 0xFF;
+        out[o + 3] = (run >> 16) & 0xFF;
+        out[o + 4] = (run >> 24) & 0xFF;
+        o += ECM_RUN_SIZE;
+        i += run;
+    }
+
+    return o;
+}
+
+// Decodes the record type runs of a chunk, returns false if they don't cover exactly count sectors
+static inline bool ecm_unpack_types(uint8_t *types, uint32_t count, const uint8_t *in, size_t size)
+{
+    uint32_t n = 0;
+
+    if (size % ECM_RUN_SIZE)
+        return false;
+
+    for (size_t i = 0; i < size; i += ECM_RUN_SIZE)
+    {
+        uint32_t run = (uint32_t)in[i + 1] | ((uint32_t)in[i + 2] << 8) | ((uint32_t)in[i + 3] << 16) | ((uint32_t)in[i + 4] << 24);
+
+        if (run > count - n)
+            return false;
+
+        memset(types + n, in[i], run);
+        n += run;
+    }
+
+    return (n == count);
+}
+
+// Checks an ecm_header_t read from a file
+static inline bool ecm_check_header(const ecm_header_t *hdr)
+{
+    return (memcmp(hdr->magic, ECM_MAGIC, sizeof(hdr->magic)) == 0 && hdr->chunk_sectors == ECM_CHUNK_SECTORS &&
+            hdr->sector_size > 0 && hdr->image_size % hdr->sector_size == 0 && hdr->num_chunks == (hdr->image_size / hdr->sector_size + ECM_CHUNK_SECTORS - 1) / ECM_CHUNK_SECTORS);
+}
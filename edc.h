@@ -0,0 +1,131 @@
+/*
+ * CD-ROM EDC (Error Detection Code)
+ * ---------------------------------
+ *
+ * The EDC is a reflected 32-bit CRC with polynomial
+ *   P(x) = x^32 + x^31 + x^16 + x^15 + x^4 + x^3 + x + 1  (0xD8018001 reflected)
+ * initial value 0 and no final XOR (the byte-wise table is EDCTable in cdrom.h).
+ *
+ * Kernels: slice-by-8 tables, and the PCLMULQDQ folding kernel from crc32.h
+ * with the EDC polynomial constants, selected at runtime through CPU dispatch.
+ *
+ * Covered ranges:
+ *   Mode 2 Form 1: subheader + user data (0x10 - 0x817), EDC at 0x818
+ *   Mode 2 Form 2: subheader + user data (0x10 - 0x92B), EDC at 0x92C
+ *
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#define EDC_CLMUL_MIN       64      // minimum length for the folding kernel
+
+typedef uint32_t (*edc_kernel_t)(uint32_t edc, const uint8_t *data, size_t size);
+
+static uint32_t edc_table[8][256];
+static edc_kernel_t edc_kernel;
+static pthread_once_t edc_once = PTHREAD_ONCE_INIT;
+
+#ifdef CRC32_HAVE_CLMUL
+static const crc_clmul_consts_t edc_clmul_consts = {
+    { 0x01f8931102, 0x012e7928a2 },
+    { 0x006c90c100, 0x01d5934102 },
+    { 0x01f1030002, 0x0000000000 },
+    { 0x01b0030003, 0x017000ffff },
+};
+#endif
+
+// Reference byte-wise kernel (same loop as PSXtract, using EDCTable from cdrom.h)
+static uint32_t edc_bytewise(uint32_t edc, const uint8_t *data, size_t size)
+{
+    while (size--)
+        edc = (edc >> 8) ^ EDCTable[(edc ^ *data++) & 0xFF];
+
+    return edc;
+}
+
+// Slice-by-8 table kernel: 8 independent lookups per 8 input bytes
+static uint32_t edc_slice8(uint32_t edc, const uint8_t *data, size_t size)
+{
+    while (size >= 8)
+    {
+        uint32_t a = ((uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24)) ^ edc;
+
+        edc = edc_table[7][ a        & 0xFF] ^ edc_table[6][(a >>  8) & 0xFF] ^
+              edc_table[5][(a >> 16) & 0xFF] ^ edc_table[4][ a >> 24        ] ^
+              edc_table[3][data[4]] ^ edc_table[2][data[5]] ^
+              edc_table[1][data[6]] ^ edc_table[0][data[7]];
+
+        data += 8;
+        size -= 8;
+    }
+
+    return edc_bytewise(edc, data, size);
+}
+
+#ifdef CRC32_HAVE_CLMUL
+static uint32_t edc_clmul(uint32_t edc, const uint8_t *data, size_t size)
+{
+    if (size < EDC_CLMUL_MIN)
+        return edc_slice8(edc, data, size);
+
+    edc = crc_clmul_fold(edc, data, size, &edc_clmul_consts);
+
+    // Remaining bytes (< 16)
+    return edc_slice8(edc, data + (size & ~(size_t)15), size & 15);
+}
+#endif
+
+// Build the slice-by-8 tables and pick the fastest kernel for this CPU
+static void edc_setup(void)
+{
+    for (int i = 0; i < 256; i++)
+        edc_table[0][i] = EDCTable[i];
+
+    for (int i = 0; i < 256; i++)
+        for (int t = 1; t < 8; t++)
+            edc_table[t][i] = (edc_table[t - 1][i] >> 8) ^ edc_table[0][edc_table[t - 1][i] & 0xFF];
+
+    edc_kernel = edc_slice8;
+
+#ifdef CRC32_HAVE_CLMUL
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1"))
+        edc_kernel = edc_clmul;
+#endif
+}
+
+// Continue an EDC computation over a data block
+static inline uint32_t edc_update(uint32_t edc, const uint8_t *data, size_t size)
+{
+    pthread_once(&edc_once, edc_setup);
+    return edc_kernel(edc, data, size);
+}
+
+// Store an EDC value (little endian)
+static inline void edc_store(uint8_t *dst, uint32_t edc)
+{
+    dst[0] = (edc >>  0) & 0xFF;
+    dst[1] = (edc >>  8) & 0xFF;
+    dst[2] = (edc >> 16) & 0xFF;
+    dst[3] = (edc >> 24) & 0xFF;
+}
+
+// Load a stored EDC value (little endian)
+static inline uint32_t edc_load(const uint8_t *src)
+{
+    return (uint32_t)src[0] | ((uint32_t)src[1] << 8) | ((uint32_t)src[2] << 16) | ((uint32_t)src[3] << 24);
+}
+
+// EDC of a CD-XA Mode 2 Form 1 sector (subheader + 2048 bytes of user data)
+static inline uint32_t edc_mode2_form1(const uint8_t *sector)
+{
+    return edc_update(0, sector + CDROMXA_SUBHEADER_OFFSET, CDROMXA_FORM1_EDC_OFFSET - CDROMXA_SUBHEADER_OFFSET);
+}
+
+// EDC of a CD-XA Mode 2 Form 2 sector (subheader + 2324 bytes of user data)
+static inline uint32_t edc_mode2_form2(const uint8_t *sector)
+{
+    return edc_update(0, sector + CDROMXA_SUBHEADER_OFFSET, CDROMXA_FORM2_EDC_OFFSET - CDROMXA_SUBHEADER_OFFSET);
+}
@@ -0,0 +1,344 @@
+/*
+ * Disc image I/O backend
+ * ----------------------
+ *
+ * Memory-mapped access to CD/DVD images: the whole image is mapped read-only
+ * for detection/verification. The 16 boot sectors are assembled in a memory
+ * buffer (logo, master disc sectors and their EDC/ECC) and committed with a
+ * single positional write, so patching costs one read and one write syscall.
+ *
+ * All other access goes through positional I/O (pread/pwrite) with 64-bit
+ * offsets: there is no shared file cursor, so several threads can read and
+ * write the same image concurrently, and files that can't be mapped (or are
+ * bigger than the address space) work the same way.
+ *
+ * Images can be cloned to a new file before patching (copy-on-write reflink
+ * where the filesystem supports it, in-kernel copy otherwise), so only the
+ * boot area of the copy gets written.
+ *
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <linux/fs.h>
+#endif
+
+typedef struct {
+    int fd;
+    uint64_t size;          // image size in bytes
+    const uint8_t *map;     // read-only mapping of the whole image (NULL if not mapped)
+    uint8_t *boot;          // in-memory copy of the boot area
+    size_t boot_size;
+} image_t;
+
+// Positional read of a whole block (retries short reads and EINTR)
+static bool image_pread(int fd, void *buf, size_t len, uint64_t offset)
+{
+    uint8_t *p = buf;
+
+    while (len)
+    {
+        ssize_t n = pread(fd, p, len, (off_t)offset);
+
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+
+        p += n;
+        len -= n;
+        offset += n;
+    }
+
+    return true;
+}
+
+// Positional write of a whole block (retries short writes and EINTR)
+static bool image_pwrite(int fd, const void *buf, size_t len, uint64_t offset)
+{
+    const uint8_t *p = buf;
+
+    while (len)
+    {
+        ssize_t n = pwrite(fd, p, len, (off_t)offset);
+
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+
+        p += n;
+        len -= n;
+        offset += n;
+    }
+
+    return true;
+}
+
+#define IMAGE_RDONLY            O_RDONLY    // read-only images (verify, inspect, conversion input)
+#define IMAGE_RDWR              O_RDWR      // images patched or repaired in place
+
+///////////////////////////////////////////////////////////
+// opens a disc image
+//
+// args:    img: image handle
+//          path: image file path
+//          mode: IMAGE_RDONLY or IMAGE_RDWR (image_write fails on read-only images)
+// returns: true  if ok
+//          false if error
+static inline bool image_open(image_t *img, const char *path, int mode)
+{
+    struct stat st;
+
+    memset(img, 0, sizeof(image_t));
+    img->fd = open(path, mode);
+    if (img->fd < 0)
+        return false;
+
+    if (fstat(img->fd, &st) != 0)
+    {
+        close(img->fd);
+        return false;
+    }
+
+    img->size = st.st_size;
+    if (img->size > 0 && img->size <= SIZE_MAX)
+    {
+        void *map = mmap(NULL, img->size, PROT_READ, MAP_SHARED, img->fd, 0);
+
+        if (map != MAP_FAILED)
+            img->map = map;
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////
+// creates a new (empty) image of a given size to be written with image_write
+// (an existing file is truncated, the image is not mapped)
+//
+// args:    img: image handle
+//          path: image file path
+//          size: image size in bytes
+// returns: true  if ok
+//          false if error
+static inline bool image_create(image_t *img, const char *path, uint64_t size)
+{
+    memset(img, 0, sizeof(image_t));
+    img->fd = -1;
+    img->size = size;
+
+    img->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0666);
+    if (img->fd < 0)
+        return false;
+
+    if (ftruncate(img->fd, size) != 0)
+    {
+        close(img->fd);
+        img->fd = -1;
+        return false;
+    }
+
+    return true;
+}
+
+// Read data from the image (plain memcpy when mapped)
+static inline bool image_read(image_t *img, uint64_t offset, void *buf, size_t len)
+{
+    if (offset > img->size || len > img->size - offset)
+        return false;
+
+    if (img->map)
+    {
+        memcpy(buf, img->map + offset, len);
+        return true;
+    }
+
+    return image_pread(img->fd, buf, len, offset);
+}
+
+// Get image data: a pointer into the mapping when mapped, else read into buf
+static inline const uint8_t* image_view(image_t *img, uint64_t offset, size_t len, uint8_t *buf)
+{
+    if (img->map)
+        return (offset <= img->size && len <= img->size - offset) ? img->map + offset : NULL;
+
+    return image_read(img, offset, buf, len) ? buf : NULL;
+}
+
+// Write data to the image (visible through the read-only mapping)
+static inline bool image_write(image_t *img, uint64_t offset, const void *buf, size_t len)
+{
+    return image_pwrite(img->fd, buf, len, offset);
+}
+
+// Copy a file range with the best method available (kernel-side when possible)
+static bool image_copy_data(int in, int out, uint64_t size, const char **method)
+{
+    uint64_t done = 0;
+
+#ifdef __linux__
+    // copy_file_range: in-kernel copy, may share extents on some filesystems
+    *method = "copy_file_range";
+    while (done < size)
+    {
+        ssize_t n = copy_file_range(in, NULL, out, NULL, size - done, 0);
+
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        done += n;
+    }
+
+    // sendfile: in-kernel copy (older kernels, cross-filesystem)
+    if (done < size)
+    {
+        off_t offset = done;
+
+        *method = "sendfile";
+        while (done < size)
+        {
+            ssize_t n = sendfile(out, in, &offset, (size - done) > 0x40000000 ? 0x40000000 : (size - done));
+
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                break;
+            done += n;
+        }
+    }
+#endif
+
+    // plain read/write copy
+    if (done < size)
+    {
+        uint8_t *buf = malloc(1 << 20);
+
+        if (!buf)
+            return false;
+
+        *method = "read/write";
+        while (done < size)
+        {
+            size_t len = (size - done) > (1 << 20) ? (1 << 20) : (size - done);
+
+            if (!image_pread(in, buf, len, done) || !image_pwrite(out, buf, len, done))
+                break;
+            done += len;
+        }
+        free(buf);
+    }
+
+    return (done == size);
+}
+
+///////////////////////////////////////////////////////////
+// creates a copy of a disc image to be patched
+// (FICLONE reflink, then copy_file_range/sendfile, then read/write)
+//
+// args:    src: source image path
+//          dst: new image path
+//          method: placeholder for the copy method used
+// returns: true  if ok
+//          false if error
+static inline bool image_clone(const char *src, const char *dst, const char **method)
+{
+    struct stat in_st, out_st;
+    int in, out;
+    bool ret = false;
+
+    in = open(src, O_RDONLY);
+    if (in < 0)
+        return false;
+
+    out = open(dst, O_WRONLY | O_CREAT, 0666);
+    if (out < 0 || fstat(in, &in_st) != 0 || fstat(out, &out_st) != 0)
+        goto done;
+
+    // never truncate the source image
+    if (in_st.st_dev == out_st.st_dev && in_st.st_ino == out_st.st_ino)
+    {
+        errno = EINVAL;
+        goto done;
+    }
+
+    if (ftruncate(out, 0) != 0)
+        goto done;
+
+#ifdef __linux__
+    // reflink: the copy shares the source extents (btrfs, XFS, ...)
+    *method = "reflink";
+    if (ioctl(out, FICLONE, in) == 0)
+    {
+        ret = true;
+        goto done;
+    }
+#endif
+
+    ret = image_copy_data(in, out, in_st.st_size, method);
+
+done:
+    if (out >= 0)
+        close(out);
+    close(in);
+    return ret;
+}
+
+///////////////////////////////////////////////////////////
+// reads the boot area (first sectors of the image) into a private buffer
+// for patching (written back by image_commit_boot)
+//
+// args:    img: image handle
+//          len: boot area size in bytes (16 sectors)
+// returns: pointer to the writable boot area, or NULL if error
+static inline uint8_t* image_read_boot(image_t *img, size_t len)
+{
+    if (len > img->size)
+        return NULL;
+
+    img->boot = malloc(len);
+    if (!img->boot)
+        return NULL;
+
+    img->boot_size = len;
+    if (!image_read(img, 0, img->boot, len))
+    {
+        free(img->boot);
+        img->boot = NULL;
+        return NULL;
+    }
+
+    return img->boot;
+}
+
+// Commit the boot area to the image file (one write for the whole area)
+static inline bool image_commit_boot(image_t *img)
+{
+    if (!img->boot)
+        return false;
+
+    return image_write(img, 0, img->boot, img->boot_size);
+}
+
+static inline void image_close(image_t *img)
+{
+    free(img->boot);
+    if (img->map)
+        munmap((void *)img->map, img->size);
+    if (img->fd >= 0)
+        close(img->fd);
+    memset(img, 0, sizeof(image_t));
+}
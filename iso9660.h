@@ -0,0 +1,281 @@
+/*
+ * ISO9660 / UDF file lookup for PS2 disc images
+ * ---------------------------------------------
+ *
+ * Minimal read-only walker used to locate files (SYSTEM.CNF) in the root
+ * directory of a PS2 CD/DVD image, so the Disc ID can be read from a handful
+ * of sectors instead of scanning the whole image.
+ *
+ * ISO9660: ECMA-119 (Primary Volume Descriptor at LBA 16)
+ * UDF:     ECMA-167 / OSTA UDF 1.02 (Anchor Volume Descriptor Pointer at LBA 256)
+ *
+ * Sectors are read through the image backend (imageio.h), with the image
+ * geometry detected by ps2m_probe_format().
+ *
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "libps2master.h"
+
+#define ISO_BLOCK_SIZE          2048
+#define ISO_PVD_LBA             16
+#define ISO_MAX_VD              16      // max volume descriptors to check before giving up
+#define ISO_MAX_DIR_SECTORS     64      // max root directory size walked (128 KB)
+
+#define UDF_AVDP_LBA            256
+#define UDF_MAX_VDS_SECTORS     32
+
+// UDF descriptor tag identifiers
+#define UDF_TAG_PVD             1
+#define UDF_TAG_AVDP            2
+#define UDF_TAG_PD              5
+#define UDF_TAG_LVD             6
+#define UDF_TAG_TD              8
+#define UDF_TAG_FSD             256
+#define UDF_TAG_FID             257
+#define UDF_TAG_FE              261
+#define UDF_TAG_EFE             266
+
+static uint16_t iso_le16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t iso_le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Read the 2048-byte user data area of a logical block
+// (CD images are CD-XA Mode 2 Form 1, user data starts at offset 0x18)
+static bool iso_read_block(image_t *img, const ps2m_ctx_t *ctx, uint32_t lba, uint8_t *buf)
+{
+    return image_read(img, (uint64_t)lba * ctx->sector_size + ctx->data_offset, buf, ISO_BLOCK_SIZE);
+}
+
+// Compare a directory entry name ("SYSTEM.CNF;1") against a file name, ignoring case and version
+static bool iso_name_match(const uint8_t *name, size_t len, const char *filename)
+{
+    size_t i;
+
+    for (i = 0; i < len && name[i] != ';'; i++)
+        if (!filename[i] || toupper(name[i]) != toupper((unsigned char)filename[i]))
+            return false;
+
+    return (filename[i] == 0);
+}
+
+///////////////////////////////////////////////////////////
+// finds a file in the root directory of the ISO9660 filesystem
+//
+// args:    img: image handle
+//          ctx: image geometry
+//          filename: file to look for (eg SYSTEM.CNF)
+//          lba: placeholder for the file extent location
+//          size: placeholder for the file size
+// returns: true  if found
+//          false if not found or the filesystem is broken
+static inline bool iso9660_find_file(image_t *img, const ps2m_ctx_t *ctx, const char *filename, uint32_t *lba, uint32_t *size)
+{
+    uint8_t block[ISO_BLOCK_SIZE];
+    uint32_t root_lba = 0, root_size = 0;
+
+    // Look for the Primary Volume Descriptor
+    for (int i = 0; i < ISO_MAX_VD; i++)
+    {
+        if (!iso_read_block(img, ctx, ISO_PVD_LBA + i, block) || memcmp(block + 1, "CD001", 5) != 0)
+            return false;
+
+        if (block[0] == 0xFF) // Volume Descriptor Set Terminator
+            return false;
+
+        if (block[0] == 0x01 && iso_le16(block + 128) == ISO_BLOCK_SIZE)
+        {
+            // Root directory record is at offset 156
+            root_lba = iso_le32(block + 156 + 2);
+            root_size = iso_le32(block + 156 + 10);
+            break;
+        }
+    }
+
+    if (!root_lba || !root_size)
+        return false;
+
+    // Walk the root directory records
+    for (uint32_t s = 0; s < (root_size + ISO_BLOCK_SIZE - 1) / ISO_BLOCK_SIZE && s < ISO_MAX_DIR_SECTORS; s++)
+    {
+        if (!iso_read_block(img, ctx, root_lba + s, block))
+            return false;
+
+        // Directory records never cross a sector boundary, a zero length means skip to the next sector
+        for (uint32_t pos = 0; pos + 33 < ISO_BLOCK_SIZE && block[pos]; pos += block[pos])
+        {
+            const uint8_t *rec = block + pos;
+
+            if (rec[0] < 33 || pos + rec[0] > ISO_BLOCK_SIZE || 33 + rec[32] > rec[0])
+                return false;
+
+            // skip directories
+            if (rec[25] & 0x02)
+                continue;
+
+            if (iso_name_match(rec + 33, rec[32], filename))
+            {
+                *lba = iso_le32(rec + 2);
+                *size = iso_le32(rec + 10);
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+// Read a UDF descriptor and validate its tag identifier and checksum
+static bool udf_read_tag(image_t *img, const ps2m_ctx_t *ctx, uint32_t lba, uint16_t tag_id, uint8_t *block)
+{
+    uint8_t sum = 0;
+
+    if (!iso_read_block(img, ctx, lba, block) || iso_le16(block) != tag_id)
+        return false;
+
+    for (int i = 0; i < 16; i++)
+        if (i != 4)
+            sum += block[i];
+
+    return (sum == block[4]);
+}
+
+// Read a UDF (Extended) File Entry and get the location and size of its first extent
+static bool udf_read_file_entry(image_t *img, const ps2m_ctx_t *ctx, uint32_t part_start, uint32_t icb_lbn,
+                                uint32_t *lba, uint32_t *size, uint8_t *block)
+{
+    uint32_t ad_offset, ea_len, ad_len;
+
+    if (udf_read_tag(img, ctx, part_start + icb_lbn, UDF_TAG_FE, block))
+    {
+        ea_len = iso_le32(block + 168);
+        ad_len = iso_le32(block + 172);
+        ad_offset = 176 + ea_len;
+    }
+    else if (udf_read_tag(img, ctx, part_start + icb_lbn, UDF_TAG_EFE, block))
+    {
+        ea_len = iso_le32(block + 208);
+        ad_len = iso_le32(block + 212);
+        ad_offset = 216 + ea_len;
+    }
+    else
+        return false;
+
+    // Information length (64-bit, images never exceed 4 GB per file)
+    *size = iso_le32(block + 56);
+
+    if (ad_offset + ad_len > ISO_BLOCK_SIZE)
+        return false;
+
+    switch (iso_le16(block + 16 + 18) & 0x07)
+    {
+    case 0: // short_ad
+    case 1: // long_ad (same leading layout: length, logical block number)
+        if (ad_len < 8)
+            return false;
+        *lba = part_start + iso_le32(block + ad_offset + 4);
+        return true;
+
+    default: // embedded data is not supported
+        return false;
+    }
+}
+
+///////////////////////////////////////////////////////////
+// finds a file in the root directory of the UDF filesystem (DVD bridge)
+//
+// args:    img: image handle
+//          ctx: image geometry (DVD)
+//          filename: file to look for (eg SYSTEM.CNF)
+//          lba: placeholder for the file extent location
+//          size: placeholder for the file size
+// returns: true  if found
+//          false if not found or the filesystem is broken
+static inline bool udf_find_file(image_t *img, const ps2m_ctx_t *ctx, const char *filename, uint32_t *lba, uint32_t *size)
+{
+    uint8_t block[ISO_BLOCK_SIZE];
+    uint8_t dir[ISO_BLOCK_SIZE];
+    uint32_t vds_lba, vds_len;
+    uint32_t part_start = 0, fsd_lbn = 0, dir_lba, dir_size;
+    bool have_pd = false, have_lvd = false;
+
+    // Anchor Volume Descriptor Pointer -> Main Volume Descriptor Sequence
+    if (!udf_read_tag(img, ctx, UDF_AVDP_LBA, UDF_TAG_AVDP, block))
+        return false;
+
+    vds_len = iso_le32(block + 16) / ISO_BLOCK_SIZE;
+    vds_lba = iso_le32(block + 20);
+
+    for (uint32_t i = 0; i < vds_len && i < UDF_MAX_VDS_SECTORS; i++)
+    {
+        if (!iso_read_block(img, ctx, vds_lba + i, block))
+            return false;
+
+        switch (iso_le16(block))
+        {
+        case UDF_TAG_PD:
+            part_start = iso_le32(block + 188);
+            have_pd = true;
+            break;
+
+        case UDF_TAG_LVD:
+            if (iso_le32(block + 212) != ISO_BLOCK_SIZE)
+                return false;
+            // File Set Descriptor location (long_ad)
+            fsd_lbn = iso_le32(block + 248 + 4);
+            have_lvd = true;
+            break;
+        }
+
+        if (iso_le16(block) == UDF_TAG_TD)
+            break;
+    }
+
+    if (!have_pd || !have_lvd)
+        return false;
+
+    // File Set Descriptor -> root directory ICB
+    if (!udf_read_tag(img, ctx, part_start + fsd_lbn, UDF_TAG_FSD, block))
+        return false;
+
+    if (!udf_read_file_entry(img, ctx, part_start, iso_le32(block + 400 + 4), &dir_lba, &dir_size, block))
+        return false;
+
+    // Walk the File Identifier Descriptors (only the first block of the root directory)
+    if (!iso_read_block(img, ctx, dir_lba, dir))
+        return false;
+
+    if (dir_size > ISO_BLOCK_SIZE)
+        dir_size = ISO_BLOCK_SIZE;
+
+    for (uint32_t pos = 0; pos + 38 <= dir_size; )
+    {
+        const uint8_t *fid = dir + pos;
+        uint32_t l_fi = fid[19];
+        uint32_t l_iu = iso_le16(fid + 36);
+        uint32_t fid_len = (38 + l_iu + l_fi + 3) & ~3;
+
+        if (iso_le16(fid) != UDF_TAG_FID || pos + fid_len > dir_size)
+            return false;
+
+        // skip parent and directories, only 8-bit (compression id 8) names are supported
+        if (!(fid[18] & 0x0A) && l_fi > 1 && fid[38 + l_iu] == 8 &&
+            iso_name_match(fid + 38 + l_iu + 1, l_fi - 1, filename))
+            return udf_read_file_entry(img, ctx, part_start, iso_le32(fid + 20 + 4), lba, size, block);
+
+        pos += fid_len;
+    }
+
+    return false;
+}
@@ -0,0 +1,1580 @@
+/*
+ * libps2master - PlayStation 2 Master Disc boot area library
+ * ----------------------------------------------------------
+ *
+ * Implementation of the libps2master API (see libps2master.h).
+ *
+ * this code is based on the notes and sample source code about the PS2 boot sectors by loser:
+ * https://github.com/mlafeldt/ps2logo/blob/master/Documentation/ps2boot.txt
+ *
+ * The code to regenerate EDC/ECC for CD images is based on the PSXtract implementation:
+ * https://github.com/xdotnano/PSXtract/blob/master/Windows/cdrom.cpp
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <ctype.h>
+
+#include "libps2master.h"
+
+#include "cdrom.h"
+#include "crc32.h"
+#include "edc.h"
+#include "ecc.h"
+#include "logocrypt.h"
+#include "memscan.h"
+
+#include "logo_raw.h"     // generated by mklogo (see Makefile)
+
+#define LOGO_CRC_EMPTY      0x6EBED2EE      // CRC-32 of an all-zero logo area
+
+
+#pragma pack(push, 1)
+typedef struct {
+    // Header section
+    char disc_name[32];
+    char producer_name[32];
+    char copyright_holder[32];
+    uint32_t year_bcd;
+    uint16_t month_bcd;
+    uint16_t day_bcd;
+    char master_disc_text[24];  // "PlayStation Master Disc "
+    uint8_t playstation_version;
+    uint8_t region;
+    uint8_t reserved1;
+    uint8_t disc_type;
+    
+    union {
+        // CD format
+        struct {
+            char cd_filler[124];
+        } cd;
+        
+        // DVD format
+        struct {
+            uint8_t dvd_byte1;
+            uint8_t dvd_byte2;
+            uint32_t sector_count_adjusted;
+            uint32_t dvd_reserved;
+            char dvd_filler[114];
+        } dvd;
+    } media_specific;
+    
+    // Common section
+    uint8_t common_byte1;
+    uint64_t common_ff;
+    uint32_t magic2_first;
+    uint8_t magic1_first;
+    uint16_t reserved2;
+    uint8_t section1_byte1;
+    uint32_t section1_value1;
+    uint32_t section1_value2;
+    uint32_t magic2_second;
+    uint8_t magic1_second;
+    uint16_t reserved3;
+    uint8_t section2_byte1;
+    uint32_t section2_value1;
+    uint32_t section2_value2;
+    uint32_t zeros1;
+    uint8_t magic3;
+    uint16_t reserved4;
+    uint32_t zeros2;
+    uint32_t zeros3;
+    uint32_t zeros4;
+    uint32_t zeros5;
+    char zeros_large[448];
+    char spaces1[48];
+    char cdvdgen_text[16];
+    char spaces2[1216];
+} MasterDiscSector;
+#pragma pack(pop)
+
+#pragma pack(push, 1)
+typedef struct {
+    // Disc identification section
+    char disc_name[32];           // Offset 0
+    char producer_name[32];       // Offset 32
+    char copyright_holder[32];    // Offset 64
+    
+    // Date information (BCD format)
+    uint32_t year_bcd;            // Offset 96
+    uint16_t month_bcd;           // Offset 100
+    uint16_t day_bcd;             // Offset 102
+    
+    // Master disc identifier
+    char master_disc[24];         // Offset 104
+    
+    // System information
+    uint8_t playstation_version;  // Offset 128
+    uint8_t region;               // Offset 129
+    uint8_t reserved1;            // Offset 130
+    uint8_t disc_type;            // Offset 131
+    
+    // Disc-specific data (union for CD/DVD)
+    union {
+        struct {
+            char cd_filler[124]; // Offset 132
+        } cd;
+        struct {
+            uint8_t dvd_byte1; // Offset 132
+            uint8_t dvd_byte2; // Offset 133
+            uint32_t sector_count_adjusted; // Offset 134
+            uint32_t dvd_reserved; // Offset 138
+            char dvd_filler[114];   // Offset 142
+        } dvd;
+    } media_specific;
+    
+    // Various system fields
+    uint8_t common_byte1;         // Offset 256
+    uint64_t common_ff1;          // Offset 257
+    uint32_t magic2_first;        // Offset 265
+    uint8_t magic1_first;         // Offset 269
+    uint16_t field_270;           // Offset 270
+    uint8_t field_272;            // Offset 272
+    uint64_t common_ff2;          // Offset 273
+    uint32_t field_281;           // Offset 281
+    uint8_t field_285;            // Offset 285
+    uint16_t field_286;           // Offset 286
+    uint8_t field_288;            // Offset 288
+    uint32_t field_289;           // Offset 289
+    uint32_t field_293;           // Offset 293
+    uint32_t magic2_second;       // Offset 297
+    uint8_t magic1_second;        // Offset 301
+    uint16_t field_302;           // Offset 302
+    uint8_t field_304;            // Offset 304
+    uint32_t field_305;           // Offset 305
+    uint32_t field_309;           // Offset 309
+    uint32_t field_313;           // Offset 313
+    uint8_t magic3;               // Offset 317
+    uint8_t field_318;            // Offset 318
+    uint8_t field_319;            // Offset 319
+    
+    // Padding sections
+    uint8_t zeros_large[448];     // Offset 320
+    char spaces1[48];             // Offset 768
+    char cdvdgen_version[16];     // Offset 816
+    char spaces2[1216];           // Offset 828
+} JapanMasterDiscSector;
+#pragma pack(pop)
+
+// The notes mention BCD format for date fields, but samples show a different encoding (text)
+static uint16_t int_to_bcd(int value)
+{
+    return (((value % 10) + 0x30) << 8) | ((value / 10) + 0x30);
+//    return ((value / 10) << 4) | (value % 10);
+}
+
+// Helper function to pad string with spaces
+static void pad_string(char *dest, const char *src, size_t length)
+{
+    strncpy(dest, src, length);
+    for (size_t i = strlen(src); i < length; i++) {
+        dest[i] = ' ';
+    }
+}
+
+static const unsigned char cd_sync[SYNC_SIZE] = {0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00};
+
+// Supported CD image sector layouts (the first match with a PVD wins)
+static const struct {
+    uint32_t sector_size;       // stride
+    uint32_t raw_offset;        // offset of the stored data in the raw 2352-byte sector
+} cd_layouts[] = {
+    { 2352,  0 },               // raw
+    { 2448,  0 },               // raw + 96 bytes of subchannel data
+    { 2336, 16 },               // no sync/header (subheader + data + EDC/ECC)
+};
+
+static uint8_t bcd(int value)
+{
+    return ((value / 10) << 4) | (value % 10);
+}
+
+// Converts a sector index to the MSF address stored in the sector header (BCD, +2 seconds lead-in)
+void ps2m_lba_to_msf(uint32_t lba, uint8_t msf[3])
+{
+    lba += 150;
+    msf[0] = bcd(lba / (60 * 75));
+    msf[1] = bcd((lba / 75) % 60);
+    msf[2] = bcd(lba % 75);
+}
+
+// Mode 1 sector layout (sync + header + 2048 bytes of user data + EDC + 8 zero bytes + P/Q)
+#define MODE1_USER_DATA_OFFSET         (HEADER_OFFSET + HEADER_SIZE)
+#define MODE1_EDC_OFFSET               (MODE1_USER_DATA_OFFSET + 2048)
+#define MODE1_ZERO_OFFSET              (MODE1_EDC_OFFSET + EDC_SIZE)
+#define MODE1_ZERO_SIZE                8
+
+#define SECTOR_BATCH                   8        // sectors converted to raw sectors per raw_sectors_fix/check call
+#define SYNC_MAX_ERRORS                2        // damaged sync bytes of a sector still taken as a data sector
+
+// EDC/ECC layout of every sector type (see ps2m_sector_type)
+static const struct {
+    uint32_t edc_start;         // EDC covered range [edc_start, edc_offset)
+    uint32_t edc_offset;
+    uint32_t zero_offset;       // reserved bytes (always zero)
+    uint32_t zero_size;
+    bool ecc;                   // P/Q parity
+    bool ecc_no_header;         // P/Q computed with a cleared header (Mode 2)
+    bool edc_optional;          // a zero EDC means no EDC (Mode 2 Form 2)
+    int flags;                  // ps2m_sector_check() type flag
+} sector_codecs[] = {
+    [PS2M_MODE1]       = { 0, MODE1_EDC_OFFSET, MODE1_ZERO_OFFSET, MODE1_ZERO_SIZE, true, false, false, PS2M_SECTOR_MODE1 },
+    [PS2M_MODE2_FORM1] = { CDROMXA_SUBHEADER_OFFSET, CDROMXA_FORM1_EDC_OFFSET, 0, 0, true, true, false, 0 },
+    [PS2M_MODE2_FORM2] = { CDROMXA_SUBHEADER_OFFSET, CDROMXA_FORM2_EDC_OFFSET, 0, 0, false, false, true, PS2M_SECTOR_FORM2 },
+};
+
+// Data sector check: sync pattern (up to SYNC_MAX_ERRORS damaged bytes) and header address of the sector index
+static bool sector_is_data(const uint8_t *sector, uint32_t lba)
+{
+    uint8_t msf[3];
+    int errors = 0;
+
+    for (int i = 0; i < SYNC_SIZE; i++)
+        errors += (sector[i] != cd_sync[i]);
+
+    ps2m_lba_to_msf(lba, msf);
+    return (errors <= SYNC_MAX_ERRORS && memcmp(&sector[HEADER_OFFSET], msf, 3) == 0);
+}
+
+int ps2m_sector_type(const uint8_t *sector, uint32_t lba)
+{
+    if (!sector_is_data(sector, lba))
+        return PS2M_MODE_NONE;
+
+    switch (sector[HEADER_OFFSET + 3])
+    {
+    case MODE_1:
+        return PS2M_MODE1;
+
+    case MODE_2:
+        return (sector[CDROMXA_SUBHEADER_OFFSET + 2] & 0x20) ? PS2M_MODE2_FORM2 : PS2M_MODE2_FORM1;
+    }
+
+    return PS2M_MODE_NONE;
+}
+
+///////////////////////////////////////////////////////////
+// regenerates the sync, EDC, reserved and P/Q parity fields of raw sectors
+//
+// args:    raw: raw 2352-byte sectors
+//          type: sector types (no PS2M_MODE_NONE)
+//          count: number of sectors (up to SECTOR_BATCH)
+static void raw_sectors_fix(uint8_t *const *raw, const int *type, int count)
+{
+    uint8_t header[HEADER_SIZE];
+
+    for (int i = 0; i < count; i++)
+    {
+        uint8_t *sector = raw[i];
+        const uint32_t edc_start = sector_codecs[type[i]].edc_start, edc_offset = sector_codecs[type[i]].edc_offset;
+
+        memcpy(sector, cd_sync, SYNC_SIZE);
+        memset(&sector[sector_codecs[type[i]].zero_offset], 0, sector_codecs[type[i]].zero_size);
+
+        if (!sector_codecs[type[i]].edc_optional || edc_load(&sector[edc_offset]) != 0)
+            edc_store(&sector[edc_offset], edc_update(0, sector + edc_start, edc_offset - edc_start));
+
+        // P/Q cover the EDC, so they come last
+        if (!sector_codecs[type[i]].ecc)
+            continue;
+
+        memcpy(header, &sector[HEADER_OFFSET], HEADER_SIZE);
+        if (sector_codecs[type[i]].ecc_no_header)
+            memset(&sector[HEADER_OFFSET], 0, HEADER_SIZE);
+        ecc_compute_pq(sector);
+        memcpy(&sector[HEADER_OFFSET], header, HEADER_SIZE);
+    }
+}
+
+///////////////////////////////////////////////////////////
+// checks the sync, header, EDC and ECC data of raw sectors
+//
+// args:    raw: raw 2352-byte sectors
+//          type: sector types (no PS2M_MODE_NONE)
+//          lba: sector indexes in the image
+//          count: number of sectors (up to SECTOR_BATCH)
+//          flags: placeholder for the ps2m_sector_check() flags of every sector
+static void raw_sectors_check(const uint8_t *const *raw, const int *type, const uint32_t *lba, int count, int *flags)
+{
+    uint8_t tmp[SECTOR_SIZE];
+    uint8_t msf[3];
+
+    for (int i = 0; i < count; i++)
+    {
+        const uint8_t *sector = raw[i];
+        const uint32_t edc_start = sector_codecs[type[i]].edc_start, edc_offset = sector_codecs[type[i]].edc_offset;
+        uint32_t stored = edc_load(&sector[edc_offset]);
+
+        flags[i] = sector_codecs[type[i]].flags;
+
+        if (memcmp(sector, cd_sync, SYNC_SIZE) != 0)
+            flags[i] |= PS2M_SECTOR_BAD_SYNC;
+
+        ps2m_lba_to_msf(lba[i], msf);
+        if (memcmp(&sector[HEADER_OFFSET], msf, 3) != 0)
+            flags[i] |= PS2M_SECTOR_BAD_ADDRESS;
+
+        if (type[i] != PS2M_MODE1 && memcmp(&sector[CDROMXA_SUBHEADER_OFFSET + 0], &sector[CDROMXA_SUBHEADER_OFFSET + 4], 4) != 0)
+            flags[i] |= PS2M_SECTOR_BAD_SUBHEADER;
+
+        if ((stored || !sector_codecs[type[i]].edc_optional) && edc_update(0, sector + edc_start, edc_offset - edc_start) != stored)
+            flags[i] |= PS2M_SECTOR_BAD_EDC;
+
+        if (!sector_codecs[type[i]].ecc)
+            continue;
+
+        memcpy(tmp, sector, SECTOR_SIZE);
+        if (sector_codecs[type[i]].ecc_no_header)
+            memset(&tmp[HEADER_OFFSET], 0, HEADER_SIZE);
+        ecc_compute_pq(tmp);
+
+        if (memcmp(&tmp[CDROMXA_FORM1_PARITY_P_OFFSET], &sector[CDROMXA_FORM1_PARITY_P_OFFSET],
+                   CDROMXA_FORM1_PARITY_P_SIZE + CDROMXA_FORM1_PARITY_Q_SIZE) != 0)
+            flags[i] |= PS2M_SECTOR_BAD_ECC;
+    }
+}
+
+///////////////////////////////////////////////////////////
+// regenerates the sync, EDC, reserved and P/Q parity fields of a raw sector
+// (Mode 1: EDC + P/Q, Mode 2 Form 1: EDC + P/Q, Mode 2 Form 2: EDC only)
+//
+// args:    sector: raw 2352-byte sector
+//          lba: sector index in the image
+// returns: true  if ok
+//          false if the sector is not a Mode 1 / Mode 2 data sector (see ps2m_sector_type)
+bool ps2m_sector_fix(uint8_t *sector, uint32_t lba)
+{
+    int type = ps2m_sector_type(sector, lba);
+
+    if (type == PS2M_MODE_NONE)
+        return false;
+
+    raw_sectors_fix(&sector, &type, 1);
+    return true;
+}
+
+///////////////////////////////////////////////////////////
+// checks the sync, header, EDC and ECC data of a raw sector
+//
+// args:    sector: raw 2352-byte sector
+//          lba: sector index in the image
+// returns: PS2M_SECTOR_OK if the sector is intact, or a combination of the
+//          PS2M_SECTOR_BAD_* flags (PS2M_SECTOR_SKIPPED for sectors that aren't
+//          Mode 1 / Mode 2 data sectors, see ps2m_sector_type,
+//          PS2M_SECTOR_MODE1 / PS2M_SECTOR_FORM2 give the sector type)
+int ps2m_sector_check(const uint8_t *sector, uint32_t lba)
+{
+    int type = ps2m_sector_type(sector, lba);
+    int flags;
+
+    if (type == PS2M_MODE_NONE)
+        return PS2M_SECTOR_SKIPPED;
+
+    raw_sectors_check(&sector, &type, &lba, 1, &flags);
+    return flags;
+}
+
+///////////////////////////////////////////////////////////
+// this calculates the 3 magic numbers mentioned above
+// 
+// args:    discNameLetters: 4 letters from the discname (eg SLES)
+//              (the letters must be between A and Z, capital letters only)
+//          discNameNumbers: the disc number (eg 12345)
+//              (the disc number must be between 0 and 99999)
+//          magic1: placeholder for magic number 1
+//          magic2: placeholder for magic number 2
+//          magic3: placeholder for magic number 3
+// returns: true  if ok
+//          false if error
+static bool calcMagicNums(const char discNameLetters[4], int discNameNumbers, unsigned char *magic1, unsigned int *magic2, unsigned char *magic3)
+{
+    unsigned int letters=0;
+    unsigned int numbers=0;
+
+    // check discname letters to make sure they are valid
+    for(int i=0; i<4; i++)
+        if(discNameLetters[i] < 'A' || discNameLetters[i] > 'Z')
+            return false;
+    // check discname numbers to make sure they are valid
+    if(discNameNumbers < 0 || discNameNumbers > 99999)
+        return false;
+    
+    // make letters fit into a single u_int
+    letters =   (unsigned int)(discNameLetters[3]<< 0) | (unsigned int)(discNameLetters[2]<< 7) |
+                (unsigned int)(discNameLetters[1]<<14) | (unsigned int)(discNameLetters[0]<<21);
+    // number already fits into a u_int
+    numbers = discNameNumbers;
+
+    // calculate magic numbers
+    *magic1 = ((numbers &  0x1F) <<  3) | ((0x0FFFFFFF & letters) >> 25);
+    *magic2 = ( numbers          >> 10) | ((0x0FFFFFFF & letters) <<  7);
+    *magic3 = ((numbers & 0x3E0) >>  2) | 0x04;
+    
+    return true;
+}
+
+static int write_master_disc_sector(MasterDiscSector *out,
+                            const char *disc_name, int disc_id,
+                            const char *producer_name,
+                            const char *copyright_holder,
+                            int year, int month, int day,
+                            uint8_t region,
+                            uint8_t disc_type,
+                            uint32_t num_image_sectors,
+                            const char *cdvdgen_version)
+{
+    char tmp_formatted[16];
+    MasterDiscSector sector;
+    
+    if (!out)
+        return -1;
+    
+    memset(&sector, 0, sizeof(sector));
+
+    // Magic numbers
+    if (!calcMagicNums(disc_name, disc_id,  &sector.magic1_first, &sector.magic2_first, &sector.magic3))
+        return -1;
+    sector.magic1_second = sector.magic1_first;
+    sector.magic2_second = sector.magic2_first;
+    
+    // Fill basic information
+    snprintf(tmp_formatted, sizeof(tmp_formatted), "%s-%05d", disc_name, disc_id);
+    pad_string(sector.disc_name, tmp_formatted, sizeof(sector.disc_name));
+    pad_string(sector.producer_name, producer_name, sizeof(sector.producer_name));
+    pad_string(sector.copyright_holder, copyright_holder, sizeof(sector.copyright_holder));
+    
+    sector.year_bcd = int_to_bcd(year % 100) << 16 | int_to_bcd(year / 100);
+    sector.month_bcd = int_to_bcd(month);
+    sector.day_bcd = int_to_bcd(day);
+    
+    memcpy(sector.master_disc_text, "PlayStation Master Disc ", sizeof(sector.master_disc_text));
+    sector.playstation_version = 0x32;
+    sector.region = region;
+    sector.reserved1 = 0x00;
+    sector.disc_type = disc_type;
+    
+    // Handle media-specific section
+    if (disc_type == PS2M_DISC_CD)
+    { // CD
+        memset(sector.media_specific.cd.cd_filler, ' ', sizeof(sector.media_specific.cd.cd_filler));
+    } else if (disc_type == PS2M_DISC_DVD)
+    { // DVD
+        sector.media_specific.dvd.dvd_byte1 = 0x01;
+        sector.media_specific.dvd.dvd_byte2 = 0x00;
+        sector.media_specific.dvd.sector_count_adjusted = ((((num_image_sectors + 15) / 16) * 16) - 1);
+        sector.media_specific.dvd.dvd_reserved = 0x00000000;
+        memset(sector.media_specific.dvd.dvd_filler, ' ', sizeof(sector.media_specific.dvd.dvd_filler));
+    }
+    
+    // Common section
+    sector.common_byte1 = 0x01;
+    sector.common_ff = 0xFFFFFFFFFFFFFFFF;
+    
+    sector.reserved2 = 0x0000;
+    sector.section1_byte1 = 0x01;
+    sector.section1_value1 = 0x0000004B;
+    sector.section1_value2 = 0x0000104A;
+        
+    sector.reserved3 = 0x0000;
+    sector.section2_byte1 = 0x03;
+    sector.section2_value1 = 0x0000004B;
+    sector.section2_value2 = 0x0000104A;
+    
+    sector.zeros1 = 0x00000000;
+    sector.reserved4 = 0x0000;
+    sector.zeros2 = 0x00000000;
+    sector.zeros3 = 0x00000000;
+    sector.zeros4 = 0x00000000;
+    sector.zeros5 = 0x00000000;
+    
+    memset(sector.zeros_large, 0x00, sizeof(sector.zeros_large));
+    memset(sector.spaces1, ' ', sizeof(sector.spaces1));
+    
+    // Format CDVDGEN text
+    snprintf(tmp_formatted, sizeof(tmp_formatted), "CDVDGEN %s", cdvdgen_version);
+    pad_string(sector.cdvdgen_text, tmp_formatted, sizeof(sector.cdvdgen_text));
+    
+    memset(sector.spaces2, ' ', sizeof(sector.spaces2));
+
+    if (region == 1) // Japan region
+    {
+        JapanMasterDiscSector *header = (JapanMasterDiscSector *)&sector;
+
+        header->magic3 = sector.magic3;
+        header->magic2_second = sector.magic2_first;
+        header->magic1_second = sector.magic1_first;
+
+        header->reserved1 = 0x30;
+        header->field_270 = 0x0000;
+        header->field_272 = 0x02;
+        header->common_ff2 = 0xFFFFFFFFFFFFFFFF;
+        header->field_281 = 0x00000000;
+        header->field_285 = 0x80;
+        header->field_286 = 0x0000;
+        header->field_288 = 0x01;
+        header->field_289 = 0x0000004B;
+        header->field_293 = 0x0000104A;
+        header->field_302 = 0x0000;
+        header->field_304 = 0x03;
+        header->field_305 = 0x0000004B;
+        header->field_309 = 0x0000104A;
+        header->field_313 = 0x00000000;
+        header->field_318 = 0x00;
+        header->field_319 = 0x80;
+    }
+
+    memcpy(out, &sector, sizeof(sector));
+    return 0;
+}
+
+// Copies a SYSTEM.CNF value (truncated to the field size)
+static void cnf_value(char *dst, size_t dst_size, const char *val, size_t len)
+{
+    if (len >= dst_size)
+        len = dst_size - 1;
+    memcpy(dst, val, len);
+    dst[len] = 0;
+}
+
+///////////////////////////////////////////////////////////
+// gets the Disc ID from a BOOT2 path (eg cdrom0:\SLUS_209.46;1)
+//
+// args:    cnf: parsed SYSTEM.CNF (boot2 path), placeholder for the Disc ID
+// returns: true  if ok
+//          false if the path is not a cdrom0: XXXX_NNN.NN file name
+static bool cnf_boot_id(ps2m_system_cnf_t *cnf)
+{
+    const char *name = cnf->boot2;
+
+    if (strncmp(name, "cdrom0:", 7) != 0)
+        return false;
+
+    // file name after the last path separator
+    for (const char *p = name + 7; *p && *p != ';'; p++)
+        if (*p == '\\' || *p == '/')
+            name = p + 1;
+    if (name == cnf->boot2)
+        name += 7;
+
+    for (int i = 0; i < 11; i++)
+        if ((i < 4 && !isalpha((unsigned char)name[i])) ||
+            ((i == 4 && name[i] != '_') || (i == 8 && name[i] != '.')) ||
+            (i > 4 && i != 8 && !isdigit((unsigned char)name[i])))
+            return false;
+
+    for (int i = 0; i < 4; i++)
+        cnf->prod_code[i] = toupper((unsigned char)name[i]);
+    cnf->prod_code[4] = 0;
+    cnf->prod_num = (name[5] - '0') * 10000 + (name[6] - '0') * 1000 + (name[7] - '0') * 100 +
+                    (name[9] - '0') * 10 + (name[10] - '0');
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////
+// tokenizes SYSTEM.CNF data in a single pass (no allocations, no copies)
+// (KEY = VALUE lines, CR/LF or LF, stops at the end of the data or at a null byte)
+//
+// args:    data: SYSTEM.CNF data
+//          size: data size
+//          cnf: placeholder for the BOOT2/VER/VMODE/HDDUNITPOWER values and the Disc ID
+// returns: true  if a valid BOOT2 line was found
+//          false otherwise
+bool ps2m_system_cnf_tokenize(const char *data, size_t size, ps2m_system_cnf_t *cnf)
+{
+    const char *p = data, *end = data + size;
+
+    memset(cnf, 0, sizeof(ps2m_system_cnf_t));
+    cnf->prod_num = -1;
+
+    while (p < end && *p)
+    {
+        const char *key, *val;
+        size_t key_len, val_len;
+
+        while (p < end && (*p == ' ' || *p == '\t'))
+            p++;
+
+        key = p;
+        while (p < end && (isalnum((unsigned char)*p) || *p == '_'))
+            p++;
+        key_len = p - key;
+
+        while (p < end && (*p == ' ' || *p == '\t'))
+            p++;
+
+        if (key_len && p < end && *p == '=')
+        {
+            for (p++; p < end && (*p == ' ' || *p == '\t'); p++)
+                ;
+
+            val = p;
+            while (p < end && *p && *p != '\r' && *p != '\n')
+                p++;
+            for (val_len = p - val; val_len && (val[val_len - 1] == ' ' || val[val_len - 1] == '\t'); val_len--)
+                ;
+
+            if (key_len == 5 && memcmp(key, "BOOT2", 5) == 0)
+                cnf_value(cnf->boot2, sizeof(cnf->boot2), val, val_len);
+            else if (key_len == 3 && memcmp(key, "VER", 3) == 0)
+                cnf_value(cnf->version, sizeof(cnf->version), val, val_len);
+            else if (key_len == 5 && memcmp(key, "VMODE", 5) == 0)
+                cnf_value(cnf->vmode, sizeof(cnf->vmode), val, val_len);
+            else if (key_len == 12 && memcmp(key, "HDDUNITPOWER", 12) == 0)
+                cnf_value(cnf->hdd_unit_power, sizeof(cnf->hdd_unit_power), val, val_len);
+        }
+
+        // next line
+        while (p < end && *p && *p != '\n')
+            p++;
+        if (p < end && *p == '\n')
+            p++;
+    }
+
+    cnf->pal = (strncmp(cnf->vmode, "PAL", 3) == 0);
+
+    return cnf_boot_id(cnf);
+}
+
+void ps2m_init(ps2m_ctx_t *ctx)
+{
+    memset(ctx, 0, sizeof(ps2m_ctx_t));
+    ctx->prod_num = -1;
+}
+
+// Sets the image geometry
+static void set_geometry(ps2m_ctx_t *ctx, uint8_t disc_type, uint32_t sector_size, uint32_t data_offset, uint32_t raw_offset, uint64_t image_size)
+{
+    ctx->disc_type = disc_type;
+    ctx->sector_size = sector_size;
+    ctx->data_offset = data_offset;
+    ctx->raw_offset = raw_offset;
+    ctx->edc_ecc = (disc_type == PS2M_DISC_CD);
+    ctx->num_sectors = image_size / sector_size;
+}
+
+bool ps2m_set_format(ps2m_ctx_t *ctx, uint8_t disc_type, uint32_t sector_size, uint32_t num_sectors)
+{
+    if (disc_type == PS2M_DISC_DVD && sector_size == PS2M_DVD_SECTOR_SIZE) {
+        set_geometry(ctx, PS2M_DISC_DVD, sector_size, 0, 0, (uint64_t)num_sectors * sector_size);
+        return true;
+    }
+
+    for (size_t i = 0; disc_type == PS2M_DISC_CD && i < sizeof(cd_layouts) / sizeof(cd_layouts[0]); i++)
+    {
+        uint32_t raw = cd_layouts[i].raw_offset;
+
+        if (cd_layouts[i].sector_size != sector_size)
+            continue;
+
+        set_geometry(ctx, PS2M_DISC_CD, sector_size, raw ? CDROMXA_SUBHEADER_SIZE : CDROMXA_FORM1_USER_DATA_OFFSET, raw, (uint64_t)num_sectors * sector_size);
+        return true;
+    }
+
+    return false;
+}
+
+// Checks for an ISO9660 volume descriptor ("\1CD001") at the given image offset
+static bool probe_pvd(const uint8_t *head, size_t len, uint64_t offset)
+{
+    return (offset + 6 <= len && memcmp(head + offset, "\1CD001", 6) == 0);
+}
+
+///////////////////////////////////////////////////////////
+// detects the image sector geometry from the image contents
+// (sync pattern, mode byte and the ISO9660 PVD at sector 16 for every layout,
+//  then the sync pattern at sector 0, then plain 2048-byte sectors)
+//
+// args:    ctx: placeholder for the image geometry
+//          head: first bytes of the image (PS2M_PROBE_SIZE, or the whole image if smaller)
+//          len: head size
+//          image_size: image size in bytes
+// returns: true  if ok
+//          false if the image format is unknown (ctx disc type PS2M_DISC_NONE)
+bool ps2m_probe_format(ps2m_ctx_t *ctx, const uint8_t *head, size_t len, uint64_t image_size)
+{
+    const uint64_t pvd = 16;
+
+    for (size_t i = 0; i < sizeof(cd_layouts) / sizeof(cd_layouts[0]); i++)
+    {
+        uint32_t size = cd_layouts[i].sector_size, raw = cd_layouts[i].raw_offset;
+        const uint8_t *sector = head + pvd * size;
+
+        if (image_size % size != 0 || (pvd + 1) * size > len)
+            continue;
+
+        // raw sectors: sync + header, the mode byte gives the user data offset
+        if (raw == 0 && memcmp(sector, cd_sync, SYNC_SIZE) == 0 &&
+            (sector[HEADER_OFFSET + 3] == MODE_1 || sector[HEADER_OFFSET + 3] == MODE_2))
+        {
+            uint32_t data = (sector[HEADER_OFFSET + 3] == MODE_1) ? CDROMXA_SUBHEADER_OFFSET : CDROMXA_FORM1_USER_DATA_OFFSET;
+
+            if (probe_pvd(head, len, pvd * size + data)) {
+                set_geometry(ctx, PS2M_DISC_CD, size, data, 0, image_size);
+                return true;
+            }
+        }
+
+        // no sync/header: subheader copies must match
+        if (raw && memcmp(sector, sector + 4, 4) == 0 && probe_pvd(head, len, pvd * size + CDROMXA_SUBHEADER_SIZE))
+        {
+            set_geometry(ctx, PS2M_DISC_CD, size, CDROMXA_SUBHEADER_SIZE, raw, image_size);
+            return true;
+        }
+    }
+
+    if (image_size % PS2M_DVD_SECTOR_SIZE == 0 && probe_pvd(head, len, pvd * PS2M_DVD_SECTOR_SIZE))
+    {
+        set_geometry(ctx, PS2M_DISC_DVD, PS2M_DVD_SECTOR_SIZE, 0, 0, image_size);
+        return true;
+    }
+
+    // no filesystem: raw CD images still start with synced boot sectors
+    for (size_t i = 0; i < sizeof(cd_layouts) / sizeof(cd_layouts[0]); i++)
+    {
+        uint32_t size = cd_layouts[i].sector_size;
+
+        if (cd_layouts[i].raw_offset || image_size % size != 0 || len < 2 * size ||
+            memcmp(head, cd_sync, SYNC_SIZE) != 0 || memcmp(head + size, cd_sync, SYNC_SIZE) != 0 ||
+            head[HEADER_OFFSET + 3] != MODE_2)
+            continue;
+
+        set_geometry(ctx, PS2M_DISC_CD, size, CDROMXA_FORM1_USER_DATA_OFFSET, 0, image_size);
+        return true;
+    }
+
+    // no filesystem and no sync: only a plain ISO of 2048-byte sectors is left
+    if (image_size % PS2M_DVD_SECTOR_SIZE == 0 && !(len >= SYNC_SIZE && memcmp(head, cd_sync, SYNC_SIZE) == 0))
+    {
+        set_geometry(ctx, PS2M_DISC_DVD, PS2M_DVD_SECTOR_SIZE, 0, 0, image_size);
+        return true;
+    }
+
+    ctx->disc_type = PS2M_DISC_NONE;
+    return false;
+}
+
+bool ps2m_set_disc_id(ps2m_ctx_t *ctx, const char prod_code[4], int prod_num, int pal)
+{
+    if (!calcMagicNums(prod_code, prod_num, &ctx->magic1, &ctx->magic2, &ctx->magic3))
+        return false;
+
+    memcpy(ctx->prod_code, prod_code, 4);
+    ctx->prod_code[4] = 0;
+    ctx->prod_num = prod_num;
+    ctx->pal = pal;
+
+    return true;
+}
+
+bool ps2m_parse_system_cnf(ps2m_ctx_t *ctx, const char *data, size_t size)
+{
+    ps2m_system_cnf_t cnf;
+
+    if (!ps2m_system_cnf_tokenize(data, size, &cnf))
+        return false;
+
+    return ps2m_set_disc_id(ctx, cnf.prod_code, cnf.prod_num, cnf.pal);
+}
+
+///////////////////////////////////////////////////////////
+// searches a run of image sectors for SYSTEM.CNF data
+// (vectorized search for "BOOT2" over the whole user data of every sector,
+//  the full BOOT2 line is only parsed on hits)
+//
+// args:    ctx: image format, placeholder for the Disc ID
+//          sectors: image sectors (image layout)
+//          count: number of sectors
+//          pos: user data position to search from (sector * 2048 + offset),
+//               placeholder for the position of the BOOT2 line
+// returns: true  if a Disc ID was found
+//          false if no SYSTEM.CNF data was found
+bool ps2m_scan_system_cnf(ps2m_ctx_t *ctx, const uint8_t *sectors, size_t count, size_t *pos)
+{
+    for (size_t i = *pos / 2048, off = *pos % 2048; i < count; i++, off = 0)
+    {
+        const uint8_t *data = sectors + i * ctx->sector_size + ctx->data_offset;
+        const uint8_t *hit;
+
+        while ((hit = memscan_find(data + off, 2048 - off, "BOOT2", 5)) != NULL)
+        {
+            char cnf[2048];
+            size_t len = data + 2048 - hit;
+
+            off = hit - data;
+            memcpy(cnf, hit, len);
+
+            // SYSTEM.CNF data continuing in the next sector
+            if (i + 1 < count)
+            {
+                memcpy(cnf + len, data + ctx->sector_size, sizeof(cnf) - len);
+                len = sizeof(cnf);
+            }
+
+            if (ps2m_parse_system_cnf(ctx, cnf, len))
+            {
+                *pos = i * 2048 + off;
+                return true;
+            }
+            off++;
+        }
+    }
+
+    *pos = count * 2048;
+    return false;
+}
+
+void ps2m_logo_encrypt(const ps2m_ctx_t *ctx, uint8_t *logo, size_t size)
+{
+    logo_encrypt(logo, size, ctx->magic1);
+}
+
+void ps2m_logo_decrypt(const ps2m_ctx_t *ctx, uint8_t *logo, size_t size)
+{
+    logo_decrypt(logo, size, ctx->magic1);
+}
+
+// CRC-32 of the (encrypted) logo stored in the boot area sectors 0-11
+static uint32_t logo_crc(const ps2m_ctx_t *ctx, const uint8_t *boot)
+{
+    crc32_ctx crc;
+
+    crc32_init(&crc);
+    for (int i = 0; i < PS2M_LOGO_SECTORS; i++)
+        crc32_update(&crc, boot + i * ctx->sector_size + ctx->data_offset, 2048);
+
+    return crc32_final(&crc);
+}
+
+// Finds a CRC in a per-magic1 logo CRC table, returns the magic1 or -1
+static int logo_find_crc(const uint32_t table[256], uint32_t crc)
+{
+#ifdef __SSE2__
+    const __m128i key = _mm_set1_epi32((int)crc);
+
+    for (int m = 0; m < 256; m += 16)
+    {
+        __m128i a = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(table + m +  0)), key);
+        __m128i b = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(table + m +  4)), key);
+        __m128i c = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(table + m +  8)), key);
+        __m128i d = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(table + m + 12)), key);
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(a)) | (_mm_movemask_ps(_mm_castsi128_ps(b)) << 4) |
+                   (_mm_movemask_ps(_mm_castsi128_ps(c)) << 8) | (_mm_movemask_ps(_mm_castsi128_ps(d)) << 12);
+
+        if (mask)
+            return m + __builtin_ctz(mask);
+    }
+#else
+    for (int m = 0; m < 256; m++)
+        if (table[m] == crc)
+            return m;
+#endif
+
+    return -1;
+}
+
+///////////////////////////////////////////////////////////
+// checks the PS2 logo stored in the boot area
+// (CRC of the encrypted logo against the expected CRC for the Disc ID magic1)
+//
+// args:    ctx: image format and Disc ID
+//          boot: boot area (image layout)
+// returns: PS2M_LOGO_EMPTY if the logo area is blank
+//          PS2M_LOGO_NTSC / PS2M_LOGO_PAL if the logo matches the Disc ID
+//          PS2M_LOGO_INVALID otherwise
+int ps2m_logo_status(const ps2m_ctx_t *ctx, const uint8_t *boot)
+{
+    uint32_t crc = logo_crc(ctx, boot);
+
+    if (crc == LOGO_CRC_EMPTY)
+        return PS2M_LOGO_EMPTY;
+
+    if (crc == logo_ntsc_crc[ctx->magic1])
+        return PS2M_LOGO_NTSC;
+
+    if (crc == logo_pal_crc[ctx->magic1])
+        return PS2M_LOGO_PAL;
+
+    return PS2M_LOGO_INVALID;
+}
+
+///////////////////////////////////////////////////////////
+// recovers the magic1 value the boot area logo was encrypted with
+// (magic1 comes from the first Disc ID letter and the low 5 bits of the number)
+//
+// args:    ctx: image format
+//          boot: boot area (image layout)
+//          magic1: placeholder for the magic1 value
+// returns: PS2M_LOGO_NTSC / PS2M_LOGO_PAL if magic1 was found
+//          PS2M_LOGO_EMPTY if the logo area is blank
+//          PS2M_LOGO_INVALID if the logo is unknown
+int ps2m_logo_recover_magic(const ps2m_ctx_t *ctx, const uint8_t *boot, uint8_t *magic1)
+{
+    uint32_t crc = logo_crc(ctx, boot);
+    int m;
+
+    if (crc == LOGO_CRC_EMPTY)
+        return PS2M_LOGO_EMPTY;
+
+    if ((m = logo_find_crc(logo_ntsc_crc, crc)) >= 0) {
+        *magic1 = m;
+        return PS2M_LOGO_NTSC;
+    }
+
+    if ((m = logo_find_crc(logo_pal_crc, crc)) >= 0) {
+        *magic1 = m;
+        return PS2M_LOGO_PAL;
+    }
+
+    return PS2M_LOGO_INVALID;
+}
+
+///////////////////////////////////////////////////////////
+// encrypts the PS2 logo straight into the boot area sectors 0-11
+// (even the extra bytes at the end of the pal logo)
+//
+// args:    ctx: image format and Disc ID (the video mode selects the logo)
+//          boot: boot area (image layout)
+// returns: true  if ok
+//          false if a CD logo sector is not a Mode 2 Form 1 sector
+bool ps2m_logo_write(const ps2m_ctx_t *ctx, uint8_t *boot)
+{
+    const uint8_t *logo = ctx->pal ? logo_pal_raw : logo_ntsc_raw;
+    bool ret = true;
+
+    // Form 2 sectors can't hold the 2048-byte logo: check them all before touching the boot area
+    if (ctx->edc_ecc)
+        for (int i = 0; i < PS2M_LOGO_SECTORS; i++)
+            if (ps2m_image_sector_type(ctx, boot + i * ctx->sector_size, i) == PS2M_MODE2_FORM2)
+                return false;
+
+    for (int i = 0; i < PS2M_LOGO_SECTORS; i++)
+    {
+        uint8_t *sector = boot + i * ctx->sector_size;
+
+        logo_encrypt_copy(sector + ctx->data_offset, logo + i * 2048, 2048, ctx->magic1);
+        if (ctx->edc_ecc)
+            ret &= ps2m_image_sector_fix(ctx, sector, i);
+    }
+
+    return ret;
+}
+
+bool ps2m_write_master_sectors(const ps2m_ctx_t *ctx, uint8_t *boot, const ps2m_master_info_t *info)
+{
+    MasterDiscSector sector;
+
+    if (write_master_disc_sector(
+        &sector,
+        ctx->prod_code, ctx->prod_num,
+        info->producer_name,
+        info->copyright_holder,
+        info->year, info->month, info->day,
+        info->region,
+        ctx->disc_type,
+        ctx->num_sectors,
+        info->cdvdgen_version) != 0)
+        return false;
+
+    // Update CD sector EDC/ECC data (Mode 1 or CD-XA Mode 2 Form 1 only), check both sectors first
+    if (ctx->edc_ecc)
+        for (int i = 14; i < 16; i++)
+            if (ps2m_image_sector_type(ctx, boot + i * ctx->sector_size, i) == PS2M_MODE2_FORM2)
+                return false;
+
+    // Write the sector twice as specified (sectors 14 & 15)
+    for (int i = 14; i < 16; i++)
+    {
+        memcpy(boot + i * ctx->sector_size + ctx->data_offset, &sector, sizeof(sector));
+
+        if (ctx->edc_ecc && !ps2m_image_sector_fix(ctx, boot + i * ctx->sector_size, i))
+            return false;
+    }
+
+    return true;
+}
+
+bool ps2m_master_disc_id(const ps2m_ctx_t *ctx, const uint8_t *boot, char disc_id[16])
+{
+    const MasterDiscSector *sector = (const MasterDiscSector *)(boot + 14 * ctx->sector_size + ctx->data_offset);
+
+    if (memcmp(sector->master_disc_text, "PlayStation Master Disc ", sizeof(sector->master_disc_text)) != 0)
+        return false;
+
+    // "XXXX-NNNNN" padded with spaces
+    for (int i = 0; i < 10; i++)
+        if ((i < 4 && !(sector->disc_name[i] >= 'A' && sector->disc_name[i] <= 'Z')) ||
+            (i == 4 && sector->disc_name[i] != '-') ||
+            (i > 4 && !(sector->disc_name[i] >= '0' && sector->disc_name[i] <= '9')))
+            return false;
+
+    memcpy(disc_id, sector->disc_name, 10);
+    disc_id[10] = 0;
+
+    return true;
+}
+
+// Copies a space padded text field (trailing spaces removed)
+static void copy_text(char *dst, const char *src, size_t len)
+{
+    memcpy(dst, src, len);
+    while (len && (dst[len - 1] == ' ' || dst[len - 1] == 0))
+        len--;
+    dst[len] = 0;
+}
+
+// Decodes the text encoded date digits (see int_to_bcd)
+static int text_to_int(const void *field, int digits)
+{
+    const char *p = field;
+    int value = 0;
+
+    for (int i = 0; i < digits; i++)
+        value = value * 10 + (p[i] - '0');
+
+    return value;
+}
+
+///////////////////////////////////////////////////////////
+// parses and validates the master disc sectors (14 & 15) of a boot area,
+// reading nothing but the boot area itself
+//
+// args:    ctx: image format (the Disc ID is set from the master disc sector)
+//          boot: boot area (image layout)
+//          status: placeholder for the parsed fields and check results
+// returns: PS2M_MASTER_OK if the sectors and magic numbers are valid
+//          PS2M_MASTER_INVALID if a master disc sector is present but damaged
+//          PS2M_MASTER_NONE if there is no master disc sector
+int ps2m_inspect(ps2m_ctx_t *ctx, const uint8_t *boot, ps2m_master_status_t *status)
+{
+    const uint8_t *data = boot + 14 * ctx->sector_size + ctx->data_offset;
+    const MasterDiscSector *sector = (const MasterDiscSector *)data;
+    const JapanMasterDiscSector *jp = (const JapanMasterDiscSector *)data;
+    uint8_t magic1, magic3;
+    uint32_t magic2;
+    char cdvdgen[17];
+
+    memset(status, 0, sizeof(ps2m_master_status_t));
+    status->status = PS2M_MASTER_NONE;
+    status->logo = PS2M_LOGO_INVALID;
+
+    if (!ps2m_master_disc_id(ctx, boot, status->disc_id))
+        return PS2M_MASTER_NONE;
+
+    copy_text(status->producer_name, sector->producer_name, sizeof(sector->producer_name));
+    copy_text(status->copyright_holder, sector->copyright_holder, sizeof(sector->copyright_holder));
+    status->year = text_to_int(&sector->year_bcd, 4);
+    status->month = text_to_int(&sector->month_bcd, 2);
+    status->day = text_to_int(&sector->day_bcd, 2);
+    status->region = sector->region;
+    status->disc_type = sector->disc_type;
+
+    copy_text(cdvdgen, sector->cdvdgen_text, sizeof(sector->cdvdgen_text));
+    snprintf(status->cdvdgen_version, sizeof(status->cdvdgen_version), "%.8s",
+             strncmp(cdvdgen, "CDVDGEN ", 8) == 0 ? cdvdgen + 8 : cdvdgen);
+
+    // Magic numbers (the second copy and magic3 move in the Japan layout)
+    status->magic1 = sector->magic1_first;
+    status->magic2 = sector->magic2_first;
+    status->magic3 = (sector->region == PS2M_REGION_JAPAN) ? jp->magic3 : sector->magic3;
+
+    status->magic_ok = calcMagicNums(status->disc_id, atoi(status->disc_id + 5), &magic1, &magic2, &magic3) &&
+        status->magic1 == magic1 && status->magic2 == magic2 && status->magic3 == magic3;
+
+    if (sector->region == PS2M_REGION_JAPAN)
+        status->magic_ok &= (jp->magic1_second == magic1 && jp->magic2_second == magic2);
+    else
+        status->magic_ok &= (sector->magic1_second == magic1 && sector->magic2_second == magic2);
+
+    // Sector copies, EDC/ECC and DVD sector count
+    status->sectors_ok = (status->disc_type == ctx->disc_type) &&
+        memcmp(data, data + ctx->sector_size, sizeof(MasterDiscSector)) == 0;
+
+    if (ctx->edc_ecc)
+    {
+        for (int i = 14; i < 16; i++)
+            if (ps2m_image_sector_check(ctx, boot + i * ctx->sector_size, i) != PS2M_SECTOR_OK)
+                status->sectors_ok = false;
+    }
+    else if (sector->media_specific.dvd.sector_count_adjusted != ((((ctx->num_sectors + 15) / 16) * 16) - 1))
+        status->sectors_ok = false;
+
+    if (status->magic_ok)
+    {
+        ps2m_set_disc_id(ctx, status->disc_id, atoi(status->disc_id + 5), 0);
+
+        status->logo = ps2m_logo_status(ctx, boot);
+        ctx->pal = (status->logo == PS2M_LOGO_PAL);
+    }
+
+    status->status = (status->magic_ok && status->sectors_ok) ? PS2M_MASTER_OK : PS2M_MASTER_INVALID;
+    return status->status;
+}
+
+// Raw 2352-byte view of an image sector: the sector itself, or a copy with the
+// sync/header rebuilt from the LBA for images stored without them (2336 bytes)
+static uint8_t* sector_raw(const ps2m_ctx_t *ctx, const uint8_t *sector, uint32_t lba, uint8_t tmp[SECTOR_SIZE])
+{
+    if (!ctx->raw_offset)
+        return (uint8_t *)sector;
+
+    memcpy(tmp, cd_sync, SYNC_SIZE);
+    ps2m_lba_to_msf(lba, tmp + HEADER_OFFSET);
+    tmp[HEADER_OFFSET + 3] = MODE_2;
+    memcpy(tmp + ctx->raw_offset, sector, SECTOR_SIZE - ctx->raw_offset);
+
+    return tmp;
+}
+
+int ps2m_image_sector_type(const ps2m_ctx_t *ctx, const uint8_t *sector, uint32_t lba)
+{
+    uint8_t tmp[SECTOR_SIZE];
+
+    return ps2m_sector_type(sector_raw(ctx, sector, lba, tmp), lba);
+}
+
+int ps2m_image_sector_check(const ps2m_ctx_t *ctx, const uint8_t *sector, uint32_t lba)
+{
+    uint8_t tmp[SECTOR_SIZE];
+
+    return ps2m_sector_check(sector_raw(ctx, sector, lba, tmp), lba);
+}
+
+bool ps2m_image_sector_fix(const ps2m_ctx_t *ctx, uint8_t *sector, uint32_t lba)
+{
+    uint8_t tmp[SECTOR_SIZE];
+    uint8_t *raw = sector_raw(ctx, sector, lba, tmp);
+
+    if (!ps2m_sector_fix(raw, lba))
+        return false;
+
+    if (raw != sector)
+        memcpy(sector, raw + ctx->raw_offset, SECTOR_SIZE - ctx->raw_offset);
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////
+// checks a run of image sectors in memory
+//
+// args:    ctx: image geometry
+//          sectors: image sectors (image layout)
+//          count: number of sectors
+//          lba: index of the first sector
+//          flags: placeholder for the ps2m_sector_check() flags of every sector
+void ps2m_sectors_check(const ps2m_ctx_t *ctx, const uint8_t *sectors, uint32_t count, uint32_t lba, int *flags)
+{
+    uint8_t tmp[SECTOR_BATCH][SECTOR_SIZE];
+    const uint8_t *raw[SECTOR_BATCH];
+    uint32_t raw_lba[SECTOR_BATCH];
+    int type[SECTOR_BATCH], raw_flags[SECTOR_BATCH], index[SECTOR_BATCH];
+
+    for (uint32_t base = 0; base < count; base += SECTOR_BATCH)
+    {
+        uint32_t n = (count - base < SECTOR_BATCH) ? count - base : SECTOR_BATCH;
+        int batch = 0;
+
+        // Mode 0 / non-data sectors are left out of the batch
+        for (uint32_t i = base; i < base + n; i++)
+        {
+            raw[batch] = sector_raw(ctx, sectors + (size_t)i * ctx->sector_size, lba + i, tmp[batch]);
+            type[batch] = ps2m_sector_type(raw[batch], lba + i);
+            flags[i] = PS2M_SECTOR_SKIPPED;
+
+            if (type[batch] != PS2M_MODE_NONE)
+            {
+                raw_lba[batch] = lba + i;
+                index[batch++] = i;
+            }
+        }
+
+        raw_sectors_check(raw, type, raw_lba, batch, raw_flags);
+        for (int k = 0; k < batch; k++)
+            flags[index[k]] = raw_flags[k];
+    }
+}
+
+///////////////////////////////////////////////////////////
+// regenerates the sync/EDC/ECC data of a run of image sectors in memory
+//
+// args:    ctx: image geometry
+//          sectors: image sectors (image layout)
+//          count: number of sectors
+//          lba: index of the first sector
+//          flags: placeholder for the sector type flags of every sector
+//                 (PS2M_SECTOR_SKIPPED/MODE1/FORM2), plus PS2M_SECTOR_FIXED
+//                 if the sector was changed
+void ps2m_sectors_fix(const ps2m_ctx_t *ctx, uint8_t *sectors, uint32_t count, uint32_t lba, int *flags)
+{
+    uint8_t tmp[SECTOR_BATCH][SECTOR_SIZE], orig[SECTOR_BATCH][SECTOR_SIZE];
+    uint8_t *raw[SECTOR_BATCH];
+    int type[SECTOR_BATCH], index[SECTOR_BATCH];
+
+    for (uint32_t base = 0; base < count; base += SECTOR_BATCH)
+    {
+        uint32_t n = (count - base < SECTOR_BATCH) ? count - base : SECTOR_BATCH;
+        int batch = 0;
+
+        for (uint32_t i = base; i < base + n; i++)
+        {
+            raw[batch] = sector_raw(ctx, sectors + (size_t)i * ctx->sector_size, lba + i, tmp[batch]);
+            type[batch] = ps2m_sector_type(raw[batch], lba + i);
+
+            // non-data sectors are left untouched
+            if (type[batch] == PS2M_MODE_NONE) {
+                flags[i] = PS2M_SECTOR_SKIPPED;
+                continue;
+            }
+
+            memcpy(orig[batch], raw[batch], SECTOR_SIZE);
+            flags[i] = sector_codecs[type[batch]].flags;
+            index[batch++] = i;
+        }
+
+        raw_sectors_fix(raw, type, batch);
+
+        for (int k = 0; k < batch; k++)
+        {
+            uint8_t *sector = sectors + (size_t)index[k] * ctx->sector_size;
+
+            if (memcmp(orig[k], raw[k], SECTOR_SIZE) != 0)
+            {
+                flags[index[k]] |= PS2M_SECTOR_FIXED;
+                if (raw[k] != sector)
+                    memcpy(sector, raw[k] + ctx->raw_offset, SECTOR_SIZE - ctx->raw_offset);
+            }
+        }
+    }
+}
+
+// Geometry of a run of contiguous raw 2352-byte sectors
+static void raw_geometry(ps2m_ctx_t *ctx, uint32_t count)
+{
+    ps2m_init(ctx);
+    set_geometry(ctx, PS2M_DISC_CD, SECTOR_SIZE, CDROMXA_FORM1_USER_DATA_OFFSET, 0, (uint64_t)count * SECTOR_SIZE);
+}
+
+///////////////////////////////////////////////////////////
+// checks a run of contiguous raw 2352-byte sectors
+// (ps2m_sector_check() of every sector, SECTOR_BATCH sectors per call)
+//
+// args:    sectors: raw sectors (count * 2352 bytes)
+//          count: number of sectors
+//          lba: index of the first sector
+//          flags: placeholder for the ps2m_sector_check() flags of every sector
+void ps2m_raw_sectors_check(const uint8_t *sectors, uint32_t count, uint32_t lba, int *flags)
+{
+    ps2m_ctx_t ctx;
+
+    raw_geometry(&ctx, count);
+    ps2m_sectors_check(&ctx, sectors, count, lba, flags);
+}
+
+///////////////////////////////////////////////////////////
+// regenerates the sync/EDC/ECC data of a run of contiguous raw 2352-byte sectors
+// (ps2m_sector_fix() of every sector, SECTOR_BATCH sectors per call)
+//
+// args:    sectors: raw sectors (count * 2352 bytes)
+//          count: number of sectors
+//          lba: index of the first sector
+//          flags: placeholder for the ps2m_sectors_fix() flags of every sector
+void ps2m_raw_sectors_fix(uint8_t *sectors, uint32_t count, uint32_t lba, int *flags)
+{
+    ps2m_ctx_t ctx;
+
+    raw_geometry(&ctx, count);
+    ps2m_sectors_fix(&ctx, sectors, count, lba, flags);
+}
+
+///////////////////////////////////////////////////////////
+// builds raw CD-XA Mode 2 Form 1 sectors from 2048-byte ISO sectors
+// (sync, MSF header, data subheader, user data, EDC and P/Q)
+//
+// args:    out: placeholder for count raw 2352-byte sectors
+//          in: ISO sectors (count * 2048 bytes)
+//          count: number of sectors
+//          lba: index of the first sector
+void ps2m_sectors_from_iso(uint8_t *out, const uint8_t *in, uint32_t count, uint32_t lba)
+{
+    static const uint8_t subheader[CDROMXA_SUBHEADER_SIZE] = { 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x08, 0x00 };
+    uint8_t *raw[SECTOR_BATCH];
+    int type[SECTOR_BATCH];
+
+    for (uint32_t base = 0; base < count; base += SECTOR_BATCH)
+    {
+        uint32_t n = (count - base < SECTOR_BATCH) ? count - base : SECTOR_BATCH;
+
+        for (uint32_t i = 0; i < n; i++)
+        {
+            uint8_t *sector = out + (size_t)(base + i) * SECTOR_SIZE;
+
+            ps2m_lba_to_msf(lba + base + i, sector + HEADER_OFFSET);
+            sector[HEADER_OFFSET + 3] = MODE_2;
+            memcpy(sector + CDROMXA_SUBHEADER_OFFSET, subheader, CDROMXA_SUBHEADER_SIZE);
+            memcpy(sector + CDROMXA_FORM1_USER_DATA_OFFSET, in + (size_t)(base + i) * PS2M_DVD_SECTOR_SIZE, PS2M_DVD_SECTOR_SIZE);
+
+            raw[i] = sector;
+            type[i] = PS2M_MODE2_FORM1;
+        }
+
+        // sync, EDC (the Form 1 EDC is never optional) and P/Q
+        raw_sectors_fix(raw, type, n);
+    }
+}
+
+///////////////////////////////////////////////////////////
+// extracts the 2048-byte user data of CD image sectors (ISO sectors)
+// (Mode 1 and Mode 0 data at 0x10, Mode 2 data at 0x18: only the first
+//  2048 bytes of Form 2 sectors are kept)
+//
+// args:    ctx: image geometry
+//          out: placeholder for count * 2048 bytes
+//          in: image sectors (image layout)
+//          count: number of sectors
+//          lba: index of the first sector
+//          flags: placeholder for the sector type flags of every sector
+//                 (PS2M_SECTOR_SKIPPED/MODE1/FORM2)
+void ps2m_sectors_to_iso(const ps2m_ctx_t *ctx, uint8_t *out, const uint8_t *in, uint32_t count, uint32_t lba, int *flags)
+{
+    uint8_t tmp[SECTOR_SIZE];
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const uint8_t *raw = sector_raw(ctx, in + (size_t)i * ctx->sector_size, lba + i, tmp);
+        int type = ps2m_sector_type(raw, lba + i);
+
+        flags[i] = (type == PS2M_MODE_NONE) ? PS2M_SECTOR_SKIPPED : sector_codecs[type].flags;
+        memcpy(out + (size_t)i * PS2M_DVD_SECTOR_SIZE,
+               raw + ((type == PS2M_MODE2_FORM1 || type == PS2M_MODE2_FORM2) ? CDROMXA_FORM1_USER_DATA_OFFSET : MODE1_USER_DATA_OFFSET),
+               PS2M_DVD_SECTOR_SIZE);
+    }
+}
+
+// Reduced sector records: stored fields of every record type (everything else
+// is regenerated: sync, header, second subheader copy, EDC, reserved bytes, P/Q)
+static const struct {
+    int codec;                  // sector type for the EDC/ECC codec
+    uint32_t subheader;         // subheader bytes stored (one copy)
+    uint32_t data_offset;       // user data
+    uint32_t data_size;
+} reduced_records[] = {
+    [PS2M_REDUCED_MODE0]       = { PS2M_MODE_NONE,   0, 0, 0 },
+    [PS2M_REDUCED_MODE1]       = { PS2M_MODE1,       0, MODE1_USER_DATA_OFFSET, 2048 },
+    [PS2M_REDUCED_FORM1]       = { PS2M_MODE2_FORM1, 4, CDROMXA_FORM1_USER_DATA_OFFSET, CDROMXA_FORM1_USER_DATA_SIZE },
+    [PS2M_REDUCED_FORM2]       = { PS2M_MODE2_FORM2, 4, CDROMXA_FORM2_USER_DATA_OFFSET, CDROMXA_FORM2_USER_DATA_SIZE },
+    [PS2M_REDUCED_FORM2_NOEDC] = { PS2M_MODE2_FORM2, 4, CDROMXA_FORM2_USER_DATA_OFFSET, CDROMXA_FORM2_USER_DATA_SIZE },
+};
+
+// Bytes of an image sector after the raw sector data (eg 96 bytes of subchannel data)
+static uint32_t sector_extra(const ps2m_ctx_t *ctx)
+{
+    return ctx->sector_size - (SECTOR_SIZE - ctx->raw_offset);
+}
+
+size_t ps2m_reduced_size(const ps2m_ctx_t *ctx, int type)
+{
+    if (type == PS2M_REDUCED_RAW)
+        return ctx->sector_size;
+
+    return reduced_records[type].subheader + reduced_records[type].data_size + sector_extra(ctx);
+}
+
+// Builds the raw sector of a reduced record, except the EDC/ECC
+// (a non-zero placeholder marks a Form 2 EDC to be computed)
+static void reduced_build(uint8_t *raw, int type, uint32_t lba, const uint8_t *record)
+{
+    memset(raw, 0, SECTOR_SIZE);
+    memcpy(raw, cd_sync, SYNC_SIZE);
+    ps2m_lba_to_msf(lba, raw + HEADER_OFFSET);
+
+    switch (reduced_records[type].codec)
+    {
+    case PS2M_MODE_NONE:
+        return;
+
+    case PS2M_MODE1:
+        raw[HEADER_OFFSET + 3] = MODE_1;
+        break;
+
+    default:
+        raw[HEADER_OFFSET + 3] = MODE_2;
+        memcpy(raw + CDROMXA_SUBHEADER_OFFSET + 0, record, 4);
+        memcpy(raw + CDROMXA_SUBHEADER_OFFSET + 4, record, 4);
+        break;
+    }
+
+    memcpy(raw + reduced_records[type].data_offset, record + reduced_records[type].subheader, reduced_records[type].data_size);
+
+    if (type == PS2M_REDUCED_FORM2)
+        raw[CDROMXA_FORM2_EDC_OFFSET] = 1;
+}
+
+// Regenerates the EDC/ECC of the built sectors (Mode 0 sectors have none)
+static void reduced_fix(uint8_t (*raw)[SECTOR_SIZE], const int *type, int count)
+{
+    uint8_t *fix[SECTOR_BATCH];
+    int codec[SECTOR_BATCH];
+    int n = 0;
+
+    for (int k = 0; k < count; k++)
+        if (reduced_records[type[k]].codec != PS2M_MODE_NONE)
+        {
+            fix[n] = raw[k];
+            codec[n++] = reduced_records[type[k]].codec;
+        }
+
+    raw_sectors_fix(fix, codec, n);
+}
+
+///////////////////////////////////////////////////////////
+// reduces a run of CD image sectors to the fields that can't be regenerated
+// (ECM style): every sector becomes a record of its type (PS2M_REDUCED_*),
+// sectors that don't rebuild bit-exact from their record are stored as is
+//
+// args:    ctx: image geometry
+//          sectors: image sectors (image layout)
+//          count: number of sectors
+//          lba: index of the first sector
+//          types: placeholder for the record type of every sector
+//          out: placeholder for the records (up to count * sector_size bytes)
+// returns: records size
+size_t ps2m_sectors_reduce(const ps2m_ctx_t *ctx, const uint8_t *sectors, uint32_t count, uint32_t lba, uint8_t *types, uint8_t *out)
+{
+    uint8_t tmp[SECTOR_SIZE], record[SECTOR_BATCH][4 + CDROMXA_FORM2_USER_DATA_SIZE];
+    uint8_t built[SECTOR_BATCH][SECTOR_SIZE];
+    uint32_t stored = SECTOR_SIZE - ctx->raw_offset, extra = sector_extra(ctx);
+    int type[SECTOR_BATCH];
+    size_t pos = 0;
+
+    for (uint32_t base = 0; base < count; base += SECTOR_BATCH)
+    {
+        uint32_t n = (count - base < SECTOR_BATCH) ? count - base : SECTOR_BATCH;
+
+        for (uint32_t k = 0; k < n; k++)
+        {
+            const uint8_t *raw = sector_raw(ctx, sectors + (size_t)(base + k) * ctx->sector_size, lba + base + k, tmp);
+
+            switch (ps2m_sector_type(raw, lba + base + k))
+            {
+            case PS2M_MODE1:
+                type[k] = PS2M_REDUCED_MODE1;
+                break;
+
+            case PS2M_MODE2_FORM1:
+                type[k] = PS2M_REDUCED_FORM1;
+                break;
+
+            case PS2M_MODE2_FORM2:
+                type[k] = edc_load(&raw[CDROMXA_FORM2_EDC_OFFSET]) ? PS2M_REDUCED_FORM2 : PS2M_REDUCED_FORM2_NOEDC;
+                break;
+
+            default:
+                type[k] = PS2M_REDUCED_MODE0;
+                break;
+            }
+
+            memcpy(record[k], raw + CDROMXA_SUBHEADER_OFFSET, reduced_records[type[k]].subheader);
+            memcpy(record[k] + reduced_records[type[k]].subheader, raw + reduced_records[type[k]].data_offset, reduced_records[type[k]].data_size);
+            reduced_build(built[k], type[k], lba + base + k, record[k]);
+        }
+
+        reduced_fix(built, type, n);
+
+        for (uint32_t k = 0; k < n; k++)
+        {
+            const uint8_t *sector = sectors + (size_t)(base + k) * ctx->sector_size;
+            size_t size = ps2m_reduced_size(ctx, type[k]) - extra;
+
+            // exception: the sector is stored as is
+            if (memcmp(built[k] + ctx->raw_offset, sector, stored) != 0)
+            {
+                types[base + k] = PS2M_REDUCED_RAW;
+                memcpy(out + pos, sector, ctx->sector_size);
+                pos += ctx->sector_size;
+                continue;
+            }
+
+            types[base + k] = type[k];
+            memcpy(out + pos, record[k], size);
+            memcpy(out + pos + size, sector + stored, extra);
+            pos += size + extra;
+        }
+    }
+
+    return pos;
+}
+
+///////////////////////////////////////////////////////////
+// rebuilds a run of CD image sectors from their ps2m_sectors_reduce() records
+//
+// args:    ctx: image geometry
+//          sectors: placeholder for the image sectors (count * sector_size bytes)
+//          count: number of sectors
+//          lba: index of the first sector
+//          types: record type of every sector
+//          in: records
+//          size: records size
+// returns: true  if ok
+//          false if the records don't match the types (corrupt data)
+bool ps2m_sectors_rebuild(const ps2m_ctx_t *ctx, uint8_t *sectors, uint32_t count, uint32_t lba, const uint8_t *types, const uint8_t *in, size_t size)
+{
+    uint8_t built[SECTOR_BATCH][SECTOR_SIZE];
+    uint32_t stored = SECTOR_SIZE - ctx->raw_offset, extra = sector_extra(ctx);
+    const uint8_t *tail[SECTOR_BATCH];
+    int type[SECTOR_BATCH];
+    size_t pos = 0;
+
+    for (uint32_t base = 0; base < count; base += SECTOR_BATCH)
+    {
+        uint32_t n = (count - base < SECTOR_BATCH) ? count - base : SECTOR_BATCH;
+
+        for (uint32_t k = 0; k < n; k++)
+        {
+            size_t len;
+
+            type[k] = types[base + k];
+            if (type[k] >= PS2M_REDUCED_TYPES)
+                return false;
+
+            len = ps2m_reduced_size(ctx, type[k]);
+            if (len > size - pos)
+                return false;
+
+            if (type[k] == PS2M_REDUCED_RAW)
+            {
+                // nothing to build, Mode 0 placeholder for the batch
+                memcpy(sectors + (size_t)(base + k) * ctx->sector_size, in + pos, len);
+                type[k] = PS2M_REDUCED_MODE0;
+                tail[k] = NULL;
+            }
+            else
+            {
+                reduced_build(built[k], type[k], lba + base + k, in + pos);
+                tail[k] = in + pos + len - extra;
+            }
+
+            pos += len;
+        }
+
+        reduced_fix(built, type, n);
+
+        for (uint32_t k = 0; k < n; k++)
+        {
+            uint8_t *sector = sectors + (size_t)(base + k) * ctx->sector_size;
+
+            if (!tail[k])
+                continue;
+
+            memcpy(sector, built[k] + ctx->raw_offset, stored);
+            memcpy(sector + stored, tail[k], extra);
+        }
+    }
+
+    return (pos == size);
+}
+
@@ -0,0 +1,235 @@
+/*
+ * libps2master - PlayStation 2 Master Disc boot area library
+ * ----------------------------------------------------------
+ *
+ * Reentrant, buffer-in/buffer-out API used by the ps2-master-patcher tool:
+ * format detection, Disc ID extraction, logo encryption/decryption, master
+ * disc sector generation and CD sector EDC/ECC, all working on caller-owned
+ * contexts and memory buffers (the boot area is patched in place).
+ *
+ * There is no mutable global state: the CPU dispatch and lookup tables are
+ * built once (pthread_once) on first use and are read-only afterwards, so any
+ * number of threads can patch images concurrently, one context per image.
+ *
+ * Typical usage:
+ *     ps2m_ctx_t ctx;
+ *     ps2m_init(&ctx);
+ *     ps2m_probe_format(&ctx, head, head_len, image_size);
+ *     ps2m_parse_system_cnf(&ctx, cnf_data, cnf_size);
+ *     if (ps2m_logo_status(&ctx, boot) == PS2M_LOGO_EMPTY)
+ *         ps2m_logo_write(&ctx, boot);
+ *     ps2m_write_master_sectors(&ctx, boot, &info);
+ *
+ */
+
+#ifndef LIBPS2MASTER_H
+#define LIBPS2MASTER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define PS2M_CD_SECTOR_SIZE     0x930           // CD-XA Mode 2 raw sector
+#define PS2M_DVD_SECTOR_SIZE    0x800
+#define PS2M_BOOT_SECTORS       16              // logo (0-11) + master disc sectors (14-15)
+#define PS2M_LOGO_SECTORS       12
+#define PS2M_LOGO_SIZE          (PS2M_LOGO_SECTORS * 2048)
+#define PS2M_PROBE_SIZE         (17 * 2448)     // image head read by ps2m_probe_format (up to the sector 16 PVD)
+
+enum {
+    PS2M_REGION_NONE = 0x00,
+    PS2M_REGION_JAPAN = 0x01,
+    PS2M_REGION_USA = 0x02,
+    PS2M_REGION_EUROPE = 0x04,
+    PS2M_REGION_WORLD = 0x07,
+};
+
+enum {
+    PS2M_DISC_NONE = 0,
+    PS2M_DISC_CD   = 1,
+    PS2M_DISC_DVD  = 2,
+};
+
+enum {
+    PS2M_LOGO_INVALID = 0,
+    PS2M_LOGO_EMPTY,
+    PS2M_LOGO_NTSC,
+    PS2M_LOGO_PAL,
+};
+
+enum {
+    PS2M_MASTER_NONE = 0,       // no master disc sector
+    PS2M_MASTER_INVALID,        // master disc sector present, but bad magic numbers or EDC/ECC
+    PS2M_MASTER_OK,
+};
+
+// ps2m_sector_type() sector types
+enum {
+    PS2M_MODE_NONE = 0,         // Mode 0 / unknown: no EDC/ECC
+    PS2M_MODE1,
+    PS2M_MODE2_FORM1,
+    PS2M_MODE2_FORM2,
+};
+
+// ps2m_sector_check() flags
+enum {
+    PS2M_SECTOR_OK           = 0x00,
+    PS2M_SECTOR_BAD_SYNC     = 0x01,
+    PS2M_SECTOR_BAD_ADDRESS  = 0x02,
+    PS2M_SECTOR_BAD_SUBHEADER= 0x04,
+    PS2M_SECTOR_BAD_EDC      = 0x08,
+    PS2M_SECTOR_BAD_ECC      = 0x10,
+    PS2M_SECTOR_MODE1        = 0x20,
+    PS2M_SECTOR_FORM2        = 0x40,
+    PS2M_SECTOR_SKIPPED      = 0x80,
+    PS2M_SECTOR_FIXED        = 0x100,   // ps2m_sectors_fix(): the sector was changed
+};
+
+// ps2m_sectors_reduce() record types
+enum {
+    PS2M_REDUCED_RAW = 0,       // sector stored as is (can't be regenerated)
+    PS2M_REDUCED_MODE0,         // zero filled Mode 0 sector (nothing stored)
+    PS2M_REDUCED_MODE1,         // 2048 bytes of user data
+    PS2M_REDUCED_FORM1,         // subheader (4 bytes) + 2048 bytes of user data
+    PS2M_REDUCED_FORM2,         // subheader (4 bytes) + 2324 bytes of user data, with EDC
+    PS2M_REDUCED_FORM2_NOEDC,   // same, EDC field zero
+    PS2M_REDUCED_TYPES,
+};
+
+typedef struct {
+    uint8_t disc_type;          // PS2M_DISC_*
+    uint32_t sector_size;       // bytes per image sector (2048/2336/2352/2448)
+    uint32_t data_offset;       // user data offset in each sector
+    uint32_t raw_offset;        // offset of the stored data in a raw 2352-byte sector (16 = no sync/header)
+    bool edc_ecc;               // sectors carry EDC/ECC (CD images)
+    uint32_t num_sectors;       // image size in sectors
+    char prod_code[5];          // disc name letters (eg SLES)
+    int prod_num;               // disc number (eg 12345), -1 if not detected
+    int pal;                    // video mode (1 = PAL)
+    uint8_t magic1;             // magic numbers derived from the Disc ID
+    uint32_t magic2;
+    uint8_t magic3;
+} ps2m_ctx_t;
+
+typedef struct {
+    uint8_t region;             // PS2M_REGION_*
+    const char *producer_name;
+    const char *copyright_holder;
+    int year, month, day;
+    const char *cdvdgen_version;
+} ps2m_master_info_t;
+
+typedef struct {
+    int status;                 // PS2M_MASTER_*
+    char disc_id[16];           // eg SLUS-20946
+    char producer_name[33];
+    char copyright_holder[33];
+    int year, month, day;
+    uint8_t region;             // PS2M_REGION_*
+    uint8_t disc_type;          // PS2M_DISC_*
+    char cdvdgen_version[9];
+    uint8_t magic1;             // stored magic numbers
+    uint32_t magic2;
+    uint8_t magic3;
+    bool magic_ok;              // magic numbers (both copies) match the Disc ID
+    bool sectors_ok;            // both sectors identical, CD sync/EDC/ECC intact, DVD sector count matches
+    int logo;                   // PS2M_LOGO_*
+} ps2m_master_status_t;
+
+typedef struct {
+    char boot2[64];             // BOOT2 path (eg cdrom0:\SLUS_209.46;1)
+    char version[16];           // VER
+    char vmode[8];              // VMODE (NTSC/PAL)
+    char hdd_unit_power[16];    // HDDUNITPOWER
+    char prod_code[5];          // Disc ID from the BOOT2 file name (eg SLUS)
+    int prod_num;               // (eg 20946), -1 if not found
+    int pal;                    // VMODE = PAL
+} ps2m_system_cnf_t;
+
+// Reset a context (no format, no Disc ID)
+void ps2m_init(ps2m_ctx_t *ctx);
+
+// Set the geometry of a DVD/ISO (2048) or CD (2336/2352/2448) image of num_sectors sectors
+bool ps2m_set_format(ps2m_ctx_t *ctx, uint8_t disc_type, uint32_t sector_size, uint32_t num_sectors);
+
+// Detect the image sector geometry from the first PS2M_PROBE_SIZE bytes of the image
+bool ps2m_probe_format(ps2m_ctx_t *ctx, const uint8_t *head, size_t len, uint64_t image_size);
+
+// Set the Disc ID (eg "SLES", 12345) and derive the magic numbers
+bool ps2m_set_disc_id(ps2m_ctx_t *ctx, const char prod_code[4], int prod_num, int pal);
+
+// Split SYSTEM.CNF data into its fields (BOOT2, VER, VMODE, HDDUNITPOWER and the BOOT2 Disc ID),
+// true if a valid BOOT2 line was found (ps2m_parse_system_cnf sets a context Disc ID from them)
+bool ps2m_system_cnf_tokenize(const char *data, size_t size, ps2m_system_cnf_t *cnf);
+
+// Extract the Disc ID from SYSTEM.CNF data (BOOT2 line)
+bool ps2m_parse_system_cnf(ps2m_ctx_t *ctx, const char *data, size_t size);
+
+// Search a run of image sectors for SYSTEM.CNF data, from a user data position (sector * 2048 + offset)
+bool ps2m_scan_system_cnf(ps2m_ctx_t *ctx, const uint8_t *sectors, size_t count, size_t *pos);
+
+// Encrypt/decrypt a logo buffer in place with the context magic1
+void ps2m_logo_encrypt(const ps2m_ctx_t *ctx, uint8_t *logo, size_t size);
+void ps2m_logo_decrypt(const ps2m_ctx_t *ctx, uint8_t *logo, size_t size);
+
+// Check the logo stored in a boot area (PS2M_LOGO_*)
+int ps2m_logo_status(const ps2m_ctx_t *ctx, const uint8_t *boot);
+
+// Recover magic1 from the encrypted logo of a boot area (PS2M_LOGO_*)
+int ps2m_logo_recover_magic(const ps2m_ctx_t *ctx, const uint8_t *boot, uint8_t *magic1);
+
+// Write the encrypted PS2 logo (NTSC/PAL from the Disc ID) into a boot area
+// (nothing is written if one of the logo sectors is Mode 2 Form 2)
+bool ps2m_logo_write(const ps2m_ctx_t *ctx, uint8_t *boot);
+
+// Write the master disc sectors (14 & 15) into a boot area
+// (nothing is written if one of them is Mode 2 Form 2)
+bool ps2m_write_master_sectors(const ps2m_ctx_t *ctx, uint8_t *boot, const ps2m_master_info_t *info);
+
+// Read the Disc ID (eg SLUS-20946) stored in the master disc sector of a boot area
+bool ps2m_master_disc_id(const ps2m_ctx_t *ctx, const uint8_t *boot, char disc_id[16]);
+
+// Parse and validate the master disc sectors and logo of a boot area
+// (on success the context Disc ID is set from the master disc sector)
+int ps2m_inspect(ps2m_ctx_t *ctx, const uint8_t *boot, ps2m_master_status_t *status);
+
+// Type of a raw 2352-byte sector (PS2M_MODE_NONE, PS2M_MODE1, PS2M_MODE2_FORM1/FORM2):
+// only sectors with a (nearly) intact sync and the header address of their index (lba)
+// are data sectors, anything else (audio, damaged headers) is PS2M_MODE_NONE
+int ps2m_sector_type(const uint8_t *sector, uint32_t lba);
+
+// Regenerate sync/EDC/ECC of a raw Mode 1 / Mode 2 sector in place
+bool ps2m_sector_fix(uint8_t *sector, uint32_t lba);
+
+// Check sync/address/EDC/ECC of a raw Mode 1 / Mode 2 sector (PS2M_SECTOR_* flags)
+int ps2m_sector_check(const uint8_t *sector, uint32_t lba);
+
+// Same as above, for a sector stored with the image geometry (2336/2352/2448 bytes)
+int ps2m_image_sector_type(const ps2m_ctx_t *ctx, const uint8_t *sector, uint32_t lba);
+bool ps2m_image_sector_fix(const ps2m_ctx_t *ctx, uint8_t *sector, uint32_t lba);
+int ps2m_image_sector_check(const ps2m_ctx_t *ctx, const uint8_t *sector, uint32_t lba);
+
+// Check / regenerate a run of image sectors in memory (PS2M_SECTOR_* flags for every sector)
+void ps2m_sectors_check(const ps2m_ctx_t *ctx, const uint8_t *sectors, uint32_t count, uint32_t lba, int *flags);
+void ps2m_sectors_fix(const ps2m_ctx_t *ctx, uint8_t *sectors, uint32_t count, uint32_t lba, int *flags);
+
+// Same as above, for contiguous raw 2352-byte sectors
+void ps2m_raw_sectors_check(const uint8_t *sectors, uint32_t count, uint32_t lba, int *flags);
+void ps2m_raw_sectors_fix(uint8_t *sectors, uint32_t count, uint32_t lba, int *flags);
+
+// Build raw Mode 2 Form 1 sectors from ISO sectors / extract the ISO sectors of CD image sectors
+void ps2m_sectors_from_iso(uint8_t *out, const uint8_t *in, uint32_t count, uint32_t lba);
+void ps2m_sectors_to_iso(const ps2m_ctx_t *ctx, uint8_t *out, const uint8_t *in, uint32_t count, uint32_t lba, int *flags);
+
+// Reduce a run of CD image sectors to the fields that can't be regenerated (records size),
+// and rebuild them bit-exact (false if the records are corrupt)
+size_t ps2m_sectors_reduce(const ps2m_ctx_t *ctx, const uint8_t *sectors, uint32_t count, uint32_t lba, uint8_t *types, uint8_t *out);
+bool ps2m_sectors_rebuild(const ps2m_ctx_t *ctx, uint8_t *sectors, uint32_t count, uint32_t lba, const uint8_t *types, const uint8_t *in, size_t size);
+
+// Size of a reduced sector record (PS2M_REDUCED_*, plus the bytes after the raw sector data)
+size_t ps2m_reduced_size(const ps2m_ctx_t *ctx, int type);
+
+// Sector index to the BCD MSF address stored in the sector header
+void ps2m_lba_to_msf(uint32_t lba, uint8_t msf[3]);
+
+#endif
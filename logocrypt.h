@@ -0,0 +1,208 @@
+/*
+ * PS2 logo encryption kernels
+ * ---------------------------
+ *
+ * The boot logo is encrypted one byte at a time with a rotate and XOR:
+ *   encrypt: y = rol(x, 5) ^ magic
+ *   decrypt: x = rol(y ^ magic, 3)
+ *
+ * SIMD versions (SSE2/AVX2/AVX-512) do the byte rotation with wide shifts
+ * plus per-byte masks (bits crossing into the neighbour byte are masked out),
+ * and the best one is picked at runtime. The scalar fallback uses a 256x256
+ * translation table (one 256-byte row per magic1), built once at setup.
+ *
+ * Encryption kernels work from a source to a destination buffer, so a static
+ * raw logo can be encrypted into the boot area buffer in a single pass.
+ *
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define LOGO_HAVE_SIMD
+#endif
+
+typedef void (*logo_encrypt_kernel_t)(uint8_t *dst, const uint8_t *src, size_t size, uint8_t magic);
+typedef void (*logo_kernel_t)(uint8_t *logo, size_t size, uint8_t magic);
+
+static uint8_t logo_xlat[256][256];     // [magic1][raw byte] = encrypted byte
+static logo_encrypt_kernel_t logo_encrypt_kernel;
+static logo_kernel_t logo_decrypt_kernel;
+static pthread_once_t logo_once = PTHREAD_ONCE_INIT;
+
+static void logo_encrypt_scalar(uint8_t *dst, const uint8_t *src, size_t size, uint8_t magic)
+{
+    const uint8_t *xlat = logo_xlat[magic];
+
+    for (size_t i = 0; i < size; i++)
+        dst[i] = xlat[src[i]];
+}
+
+static void logo_decrypt_scalar(uint8_t *logo, size_t size, uint8_t magic)
+{
+    for (size_t i = 0; i < size; i++)
+        logo[i] = ((logo[i] ^ magic) >> 5) | ((logo[i] ^ magic) << 3);
+}
+
+#ifdef LOGO_HAVE_SIMD
+__attribute__((target("sse2")))
+static void logo_encrypt_sse2(uint8_t *dst, const uint8_t *src, size_t size, uint8_t magic)
+{
+    const __m128i hi = _mm_set1_epi8((char)0xE0);
+    const __m128i lo = _mm_set1_epi8(0x1F);
+    const __m128i key = _mm_set1_epi8((char)magic);
+    size_t i;
+
+    for (i = 0; i + 16 <= size; i += 16)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i y = _mm_or_si128(_mm_and_si128(_mm_slli_epi16(x, 5), hi), _mm_and_si128(_mm_srli_epi16(x, 3), lo));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_xor_si128(y, key));
+    }
+
+    logo_encrypt_scalar(dst + i, src + i, size - i, magic);
+}
+
+__attribute__((target("sse2")))
+static void logo_decrypt_sse2(uint8_t *logo, size_t size, uint8_t magic)
+{
+    const __m128i hi = _mm_set1_epi8((char)0xF8);
+    const __m128i lo = _mm_set1_epi8(0x07);
+    const __m128i key = _mm_set1_epi8((char)magic);
+    size_t i;
+
+    for (i = 0; i + 16 <= size; i += 16)
+    {
+        __m128i x = _mm_xor_si128(_mm_loadu_si128((__m128i *)(logo + i)), key);
+        __m128i y = _mm_or_si128(_mm_and_si128(_mm_slli_epi16(x, 3), hi), _mm_and_si128(_mm_srli_epi16(x, 5), lo));
+        _mm_storeu_si128((__m128i *)(logo + i), y);
+    }
+
+    logo_decrypt_scalar(logo + i, size - i, magic);
+}
+
+__attribute__((target("avx2")))
+static void logo_encrypt_avx2(uint8_t *dst, const uint8_t *src, size_t size, uint8_t magic)
+{
+    const __m256i hi = _mm256_set1_epi8((char)0xE0);
+    const __m256i lo = _mm256_set1_epi8(0x1F);
+    const __m256i key = _mm256_set1_epi8((char)magic);
+    size_t i;
+
+    for (i = 0; i + 32 <= size; i += 32)
+    {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(src + i));
+        __m256i y = _mm256_or_si256(_mm256_and_si256(_mm256_slli_epi16(x, 5), hi), _mm256_and_si256(_mm256_srli_epi16(x, 3), lo));
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_xor_si256(y, key));
+    }
+
+    logo_encrypt_scalar(dst + i, src + i, size - i, magic);
+}
+
+__attribute__((target("avx2")))
+static void logo_decrypt_avx2(uint8_t *logo, size_t size, uint8_t magic)
+{
+    const __m256i hi = _mm256_set1_epi8((char)0xF8);
+    const __m256i lo = _mm256_set1_epi8(0x07);
+    const __m256i key = _mm256_set1_epi8((char)magic);
+    size_t i;
+
+    for (i = 0; i + 32 <= size; i += 32)
+    {
+        __m256i x = _mm256_xor_si256(_mm256_loadu_si256((__m256i *)(logo + i)), key);
+        __m256i y = _mm256_or_si256(_mm256_and_si256(_mm256_slli_epi16(x, 3), hi), _mm256_and_si256(_mm256_srli_epi16(x, 5), lo));
+        _mm256_storeu_si256((__m256i *)(logo + i), y);
+    }
+
+    logo_decrypt_scalar(logo + i, size - i, magic);
+}
+
+// AVX-512F: 64-bit lane shifts, the byte merge is a single ternary-logic blend (mask ? a : b)
+__attribute__((target("avx512f")))
+static void logo_encrypt_avx512(uint8_t *dst, const uint8_t *src, size_t size, uint8_t magic)
+{
+    const __m512i hi = _mm512_set1_epi8((char)0xE0);
+    const __m512i key = _mm512_set1_epi8((char)magic);
+    size_t i;
+
+    for (i = 0; i + 64 <= size; i += 64)
+    {
+        __m512i x = _mm512_loadu_si512((const void *)(src + i));
+        __m512i y = _mm512_ternarylogic_epi64(hi, _mm512_slli_epi64(x, 5), _mm512_srli_epi64(x, 3), 0xCA);
+        _mm512_storeu_si512((void *)(dst + i), _mm512_xor_si512(y, key));
+    }
+
+    logo_encrypt_scalar(dst + i, src + i, size - i, magic);
+}
+
+__attribute__((target("avx512f")))
+static void logo_decrypt_avx512(uint8_t *logo, size_t size, uint8_t magic)
+{
+    const __m512i hi = _mm512_set1_epi8((char)0xF8);
+    const __m512i key = _mm512_set1_epi8((char)magic);
+    size_t i;
+
+    for (i = 0; i + 64 <= size; i += 64)
+    {
+        __m512i x = _mm512_xor_si512(_mm512_loadu_si512((void *)(logo + i)), key);
+        __m512i y = _mm512_ternarylogic_epi64(hi, _mm512_slli_epi64(x, 3), _mm512_srli_epi64(x, 5), 0xCA);
+        _mm512_storeu_si512((void *)(logo + i), y);
+    }
+
+    logo_decrypt_scalar(logo + i, size - i, magic);
+}
+#endif
+
+// Build the translation table and pick the widest kernel supported by this CPU
+static void logo_setup(void)
+{
+    for (int m = 0; m < 256; m++)
+        for (int x = 0; x < 256; x++)
+            logo_xlat[m][x] = (uint8_t)((x << 5) | (x >> 3)) ^ m;
+
+    logo_encrypt_kernel = logo_encrypt_scalar;
+    logo_decrypt_kernel = logo_decrypt_scalar;
+
+#ifdef LOGO_HAVE_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+    {
+        logo_encrypt_kernel = logo_encrypt_avx512;
+        logo_decrypt_kernel = logo_decrypt_avx512;
+    }
+    else if (__builtin_cpu_supports("avx2"))
+    {
+        logo_encrypt_kernel = logo_encrypt_avx2;
+        logo_decrypt_kernel = logo_decrypt_avx2;
+    }
+    else if (__builtin_cpu_supports("sse2"))
+    {
+        logo_encrypt_kernel = logo_encrypt_sse2;
+        logo_decrypt_kernel = logo_decrypt_sse2;
+    }
+#endif
+}
+
+// Encrypt a raw logo buffer in place with the given magic number (magic1)
+static inline void logo_encrypt(uint8_t *logo, size_t size, uint8_t magic)
+{
+    pthread_once(&logo_once, logo_setup);
+    logo_encrypt_kernel(logo, logo, size, magic);
+}
+
+// Encrypt a raw logo into a destination buffer in one pass (magic1)
+static inline void logo_encrypt_copy(uint8_t *dst, const uint8_t *src, size_t size, uint8_t magic)
+{
+    pthread_once(&logo_once, logo_setup);
+    logo_encrypt_kernel(dst, src, size, magic);
+}
+
+// Decrypt an encrypted logo buffer in place with the given magic number (magic1)
+static inline void logo_decrypt(uint8_t *logo, size_t size, uint8_t magic)
+{
+    pthread_once(&logo_once, logo_setup);
+    logo_decrypt_kernel(logo, size, magic);
+}
@@ -0,0 +1,110 @@
+/*
+ * Pattern search kernels
+ * ----------------------
+ *
+ * memmem() for short patterns (eg "BOOT2") over large sector buffers.
+ *
+ * SIMD versions (SSE2/AVX2) compare the first and the last pattern byte at
+ * 16/32 candidate positions at once, and only positions where both bytes
+ * match are checked with memcmp, so most of the buffer is skipped with two
+ * compares per vector. The best one is picked at runtime, the libc memmem()
+ * is the fallback.
+ *
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MEMSCAN_HAVE_SIMD
+#endif
+
+typedef const uint8_t* (*memscan_kernel_t)(const uint8_t *data, size_t size, const uint8_t *pat, size_t len);
+
+static memscan_kernel_t memscan_kernel;
+static pthread_once_t memscan_once = PTHREAD_ONCE_INIT;
+
+static const uint8_t* memscan_scalar(const uint8_t *data, size_t size, const uint8_t *pat, size_t len)
+{
+    return memmem(data, size, pat, len);
+}
+
+#ifdef MEMSCAN_HAVE_SIMD
+__attribute__((target("sse2")))
+static const uint8_t* memscan_sse2(const uint8_t *data, size_t size, const uint8_t *pat, size_t len)
+{
+    const __m128i first = _mm_set1_epi8((char)pat[0]);
+    const __m128i last = _mm_set1_epi8((char)pat[len - 1]);
+    size_t i;
+
+    for (i = 0; i + len - 1 + 16 <= size; i += 16)
+    {
+        __m128i a = _mm_cmpeq_epi8(first, _mm_loadu_si128((const __m128i *)(data + i)));
+        __m128i b = _mm_cmpeq_epi8(last, _mm_loadu_si128((const __m128i *)(data + i + len - 1)));
+        unsigned int mask = _mm_movemask_epi8(_mm_and_si128(a, b));
+
+        for (; mask; mask &= mask - 1)
+        {
+            size_t k = i + __builtin_ctz(mask);
+
+            if (memcmp(data + k + 1, pat + 1, len - 2) == 0)
+                return data + k;
+        }
+    }
+
+    return memscan_scalar(data + i, size - i, pat, len);
+}
+
+__attribute__((target("avx2")))
+static const uint8_t* memscan_avx2(const uint8_t *data, size_t size, const uint8_t *pat, size_t len)
+{
+    const __m256i first = _mm256_set1_epi8((char)pat[0]);
+    const __m256i last = _mm256_set1_epi8((char)pat[len - 1]);
+    size_t i;
+
+    for (i = 0; i + len - 1 + 32 <= size; i += 32)
+    {
+        __m256i a = _mm256_cmpeq_epi8(first, _mm256_loadu_si256((const __m256i *)(data + i)));
+        __m256i b = _mm256_cmpeq_epi8(last, _mm256_loadu_si256((const __m256i *)(data + i + len - 1)));
+        unsigned int mask = _mm256_movemask_epi8(_mm256_and_si256(a, b));
+
+        for (; mask; mask &= mask - 1)
+        {
+            size_t k = i + __builtin_ctz(mask);
+
+            if (memcmp(data + k + 1, pat + 1, len - 2) == 0)
+                return data + k;
+        }
+    }
+
+    return memscan_scalar(data + i, size - i, pat, len);
+}
+#endif
+
+// Pick the widest kernel supported by this CPU
+static void memscan_setup(void)
+{
+    memscan_kernel = memscan_scalar;
+
+#ifdef MEMSCAN_HAVE_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        memscan_kernel = memscan_avx2;
+    else if (__builtin_cpu_supports("sse2"))
+        memscan_kernel = memscan_sse2;
+#endif
+}
+
+// Find the first occurrence of a pattern in a buffer (NULL if not found)
+static inline const uint8_t* memscan_find(const uint8_t *data, size_t size, const char *pat, size_t len)
+{
+    pthread_once(&memscan_once, memscan_setup);
+
+    if (len < 2 || len > size)
+        return memscan_scalar(data, size, (const uint8_t *)pat, len);
+
+    return memscan_kernel(data, size, (const uint8_t *)pat, len);
+}
@@ -0,0 +1,73 @@
+/*
+ * mklogo - build step for the PS2 Master Disc Boot Patcher
+ * --------------------------------------------------------
+ *
+ * Decompresses the LZARI packed NTSC/PAL logos (logo_ntsc.h, logo_pal.h) and
+ * writes them as static C tables, so the patcher doesn't need to run the
+ * LZARI decoder at runtime.
+ *
+ * Also writes the CRC-32 of each logo encrypted with every magic1 value, so
+ * the magic1 of an encrypted logo is found with a single CRC and a lookup.
+ *
+ * usage: mklogo <output.h>
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "lzari.h"
+#include "crc32.h"
+
+#include "logo_ntsc.h"
+#include "logo_pal.h"
+
+#define LOGO_SIZE       (12 * 2048)     // 12 sectors of 2048 bytes
+
+static void write_table(FILE *fp, const char *name, unsigned char *lz, int lz_size)
+{
+    unsigned char logo[LOGO_SIZE], enc[LOGO_SIZE];
+
+    memset(logo, 0, sizeof(logo));
+    unlzari(lz, lz_size, logo, sizeof(logo));
+
+    fprintf(fp, "static const unsigned char %s_raw[%d] = {", name, LOGO_SIZE);
+    for (int i = 0; i < LOGO_SIZE; i++)
+        fprintf(fp, "%s0x%02x,", (i % 12) ? " " : "\n  ", logo[i]);
+    fprintf(fp, "\n};\n\n");
+
+    // CRC-32 of the encrypted logo for every magic1 (see logocrypt.h)
+    fprintf(fp, "static const uint32_t %s_crc[256] = {", name);
+    for (int m = 0; m < 256; m++)
+    {
+        for (int i = 0; i < LOGO_SIZE; i++)
+            enc[i] = (unsigned char)((logo[i] << 5) | (logo[i] >> 3)) ^ m;
+
+        fprintf(fp, "%s0x%08x,", (m % 6) ? " " : "\n  ", crc32_calc(enc, LOGO_SIZE));
+    }
+    fprintf(fp, "\n};\n\n");
+}
+
+int main(int argc, char *argv[])
+{
+    FILE *fp;
+
+    if (argc != 2) {
+        printf("usage: %s <output.h>\n", argv[0]);
+        return -1;
+    }
+
+    fp = fopen(argv[1], "w");
+    if (!fp) {
+        perror("Failed to open file!");
+        return -1;
+    }
+
+    fprintf(fp, "// Generated by mklogo from logo_ntsc.h and logo_pal.h - do not edit\n\n");
+    fprintf(fp, "#define LOGO_RAW_SIZE %d\n\n", LOGO_SIZE);
+    write_table(fp, "logo_ntsc", lz_ntsc_bin, sizeof(lz_ntsc_bin));
+    write_table(fp, "logo_pal", lz_pal_bin, sizeof(lz_pal_bin));
+
+    fclose(fp);
+    return 0;
+}
@@ -0,0 +1,180 @@
+/*
+ * Ordered chunk pipeline
+ * ----------------------
+ *
+ * Whole-image passes (repair, convert, ECM) stream the image in chunks:
+ * one reader thread reads the chunks in order, a pool of worker threads
+ * processes them in any order, and the calling thread writes them in order.
+ *
+ * At most num_slots chunks are in flight, chunk c uses slot c % num_slots.
+ * Every slot records which chunk it holds next to its state, so a thread
+ * waiting for chunk c never takes the slot while it still holds chunk
+ * c - num_slots.
+ *
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+enum {
+    PIPELINE_FREE = 0,          // waiting for the reader
+    PIPELINE_READ,              // waiting for a worker
+    PIPELINE_DONE,              // waiting for the writer
+};
+
+typedef struct {
+    void *arg;                  // callback argument
+    uint32_t num_chunks;
+    int num_slots;              // chunks in flight
+    int threads;                // worker threads
+    void (*read)(void *arg, int slot, uint32_t chunk);     // reader thread, in chunk order
+    void (*work)(void *arg, int slot, uint32_t chunk);     // worker threads, any order
+    void (*write)(void *arg, int slot, uint32_t chunk);    // calling thread, in chunk order
+} pipeline_t;
+
+typedef struct {
+    const pipeline_t *p;
+    uint32_t *chunk;            // chunk held (or expected next) by every slot
+    int *state;                 // PIPELINE_* state of every slot
+    uint32_t next_work;
+    bool abort;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} pipeline_state_t;
+
+// Waits until the slot of a chunk holds it in the given state (-1 if the run was aborted)
+static int pipeline_wait(pipeline_state_t *s, uint32_t chunk, int state)
+{
+    int slot = chunk % s->p->num_slots;
+    bool abort;
+
+    pthread_mutex_lock(&s->lock);
+    while (!s->abort && (s->chunk[slot] != chunk || s->state[slot] != state))
+        pthread_cond_wait(&s->cond, &s->lock);
+    abort = s->abort;
+    pthread_mutex_unlock(&s->lock);
+
+    return abort ? -1 : slot;
+}
+
+static void pipeline_set(pipeline_state_t *s, int slot, uint32_t chunk, int state)
+{
+    pthread_mutex_lock(&s->lock);
+    s->chunk[slot] = chunk;
+    s->state[slot] = state;
+    pthread_cond_broadcast(&s->cond);
+    pthread_mutex_unlock(&s->lock);
+}
+
+static void* pipeline_reader(void *arg)
+{
+    pipeline_state_t *s = arg;
+
+    for (uint32_t c = 0; c < s->p->num_chunks; c++)
+    {
+        int slot = pipeline_wait(s, c, PIPELINE_FREE);
+
+        if (slot < 0)
+            break;
+
+        s->p->read(s->p->arg, slot, c);
+        pipeline_set(s, slot, c, PIPELINE_READ);
+    }
+
+    return NULL;
+}
+
+static void* pipeline_worker(void *arg)
+{
+    pipeline_state_t *s = arg;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&s->lock);
+        uint32_t c = s->next_work++;
+        pthread_mutex_unlock(&s->lock);
+
+        if (c >= s->p->num_chunks)
+            break;
+
+        int slot = pipeline_wait(s, c, PIPELINE_READ);
+
+        if (slot < 0)
+            break;
+
+        s->p->work(s->p->arg, slot, c);
+        pipeline_set(s, slot, c, PIPELINE_DONE);
+    }
+
+    return NULL;
+}
+
+///////////////////////////////////////////////////////////
+// runs a pipeline: reader thread -> worker threads -> writer (calling thread)
+// (if only some of the worker threads start, the run goes on with them)
+//
+// args:    p: callbacks, number of chunks, slots and worker threads
+// returns: true  if every chunk went through the pipeline
+//          false if the pipeline could not be started (nothing was read)
+static inline bool pipeline_run(const pipeline_t *p)
+{
+    pipeline_state_t s;
+    pthread_t reader, *tids;
+    int started = 0;
+    bool ret = false;
+
+    memset(&s, 0, sizeof(s));
+    s.p = p;
+    s.chunk = calloc(p->num_slots, sizeof(uint32_t));
+    s.state = calloc(p->num_slots, sizeof(int));
+    tids = calloc(p->threads, sizeof(pthread_t));
+    pthread_mutex_init(&s.lock, NULL);
+    pthread_cond_init(&s.cond, NULL);
+
+    if (!s.chunk || !s.state || !tids)
+        goto done;
+
+    // slot i starts free for chunk i
+    for (int i = 0; i < p->num_slots; i++)
+        s.chunk[i] = i;
+
+    while (started < p->threads && pthread_create(&tids[started], NULL, pipeline_worker, &s) == 0)
+        started++;
+
+    if (started && pthread_create(&reader, NULL, pipeline_reader, &s) == 0)
+    {
+        for (uint32_t c = 0; c < p->num_chunks; c++)
+        {
+            int slot = pipeline_wait(&s, c, PIPELINE_DONE);
+
+            p->write(p->arg, slot, c);
+            pipeline_set(&s, slot, c + p->num_slots, PIPELINE_FREE);
+        }
+
+        pthread_join(reader, NULL);
+        ret = true;
+    }
+    else
+    {
+        // release the workers waiting for chunks that will never be read
+        pthread_mutex_lock(&s.lock);
+        s.abort = true;
+        pthread_cond_broadcast(&s.cond);
+        pthread_mutex_unlock(&s.lock);
+    }
+
+    for (int i = 0; i < started; i++)
+        pthread_join(tids[i], NULL);
+
+done:
+    free(tids);
+    free(s.state);
+    free(s.chunk);
+    pthread_cond_destroy(&s.cond);
+    pthread_mutex_destroy(&s.lock);
+
+    return ret;
+}
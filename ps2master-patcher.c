@@ -8,6 +8,9 @@
  * The code to regenerate EDC/ECC for CD images is based on the PSXtract implementation:
  * https://github.com/xdotnano/PSXtract/blob/master/Windows/cdrom.cpp
  *
+ * The boot area logic lives in libps2master (libps2master.h), this file is the
+ * command line front end (image I/O, batch, verify, repair, convert and ecm modes).
+ *
  */
 
 #include <stdio.h>
@@ -16,749 +19,2121 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "libps2master.h"
+#include "imageio.h"
+#include "pipeline.h"
+#include "iso9660.h"
+#include "backup.h"
+#include "ecm.h"
+
+typedef struct {
+    const char *path;
+    uint8_t region;
+    char producer_name[33];
+    char copyright_holder[33];
+    int year, month, day;
+    char cdvdgen_version[9];
+    const char *output_path;    // NULL = patch in place, else patch a copy of the image
+    int scan_threads;           // Disc ID fallback scan threads (0 = number of CPUs)
+} patch_job_t;
+
+typedef struct {
+    int status;                 // 0 = ok
+    char disc_id[16];
+    uint8_t disc_type;
+    char message[80];
+} patch_result_t;
+
+void set_job_defaults(patch_job_t *job, const char *path, uint8_t region)
+{
+    memset(job, 0, sizeof(patch_job_t));
+    job->path = path;
+    job->region = region;
+    strcpy(job->producer_name, "PS2 PATCHER");
+    strcpy(job->copyright_holder, "SCE");
+    job->year = 2009;
+    job->month = 10;
+    job->day = 3;
+    strcpy(job->cdvdgen_version, "2.00");
+}
+
+// Checks if a valid master disc sector was written with the same job settings
+static bool master_matches_job(const ps2m_master_status_t *master, const patch_job_t *job)
+{
+    return (master->status == PS2M_MASTER_OK &&
+            (master->logo == PS2M_LOGO_NTSC || master->logo == PS2M_LOGO_PAL) &&
+            master->region == job->region &&
+            strcmp(master->producer_name, job->producer_name) == 0 &&
+            strcmp(master->copyright_holder, job->copyright_holder) == 0 &&
+            master->year == job->year && master->month == job->month && master->day == job->day &&
+            strcmp(master->cdvdgen_version, job->cdvdgen_version) == 0);
+}
+
+// Detects the image sector geometry from the first sectors of the image
+static bool probe_image(image_t *img, ps2m_ctx_t *ctx)
+{
+    uint8_t head[PS2M_PROBE_SIZE];
+    size_t len = (img->size < sizeof(head)) ? img->size : sizeof(head);
+    const uint8_t *data = image_view(img, 0, len, head);
+
+    return (data && ps2m_probe_format(ctx, data, len, img->size));
+}
+
+int get_cpu_count(void)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return (n > 0) ? (int)n : 1;
+}
+
+#define SCAN_BLOCK_SECTORS      2048        // sectors per work item in the Disc ID fallback scan (4-5 MB)
+
+typedef struct {
+    image_t *img;
+    const ps2m_ctx_t *ctx;
+    int logo_magic;             // -1 = any candidate
+    uint32_t num_sectors;
+    uint32_t next;              // next block to scan
+    uint64_t match;             // lowest offset of a candidate matching the logo (UINT64_MAX = none)
+    uint64_t first;             // lowest offset of any candidate
+    ps2m_ctx_t match_ctx, first_ctx;
+    pthread_mutex_t lock;
+} scan_t;
+
+// Scans blocks of sectors in LBA order, stops at the first candidate matching the logo magic1
+// (blocks past a match are never read)
+static void* scan_worker(void *arg)
+{
+    scan_t *s = arg;
+    const ps2m_ctx_t *ctx = s->ctx;
+    uint8_t *buf = NULL;
+
+    if (!s->img->map && !(buf = malloc((SCAN_BLOCK_SECTORS + 1) * ctx->sector_size)))
+        return NULL;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&s->lock);
+        uint32_t lba = s->next;
+        s->next += SCAN_BLOCK_SECTORS;
+        bool cancel = ((uint64_t)lba * ctx->sector_size >= s->match);
+        pthread_mutex_unlock(&s->lock);
+
+        // blocks are handed out in order: everything left is past the winner
+        if (lba >= s->num_sectors || cancel)
+            break;
+
+        // one extra sector for SYSTEM.CNF data crossing the block end
+        uint32_t count = (s->num_sectors - lba > SCAN_BLOCK_SECTORS) ? SCAN_BLOCK_SECTORS + 1 : s->num_sectors - lba;
+        const uint8_t *data = image_view(s->img, (uint64_t)lba * ctx->sector_size, (size_t)count * ctx->sector_size, buf);
+        ps2m_ctx_t cand = *ctx;
+        size_t pos = 0;
+
+        while (data && ps2m_scan_system_cnf(&cand, data, count, &pos) && pos < SCAN_BLOCK_SECTORS * 2048)
+        {
+            uint64_t offset = (uint64_t)(lba + pos / 2048) * ctx->sector_size + ctx->data_offset + pos % 2048;
+            bool found = (s->logo_magic < 0 || cand.magic1 == s->logo_magic);
+
+            pthread_mutex_lock(&s->lock);
+            if (offset < s->first) {
+                s->first = offset;
+                s->first_ctx = cand;
+            }
+            if (found && offset < s->match) {
+                s->match = offset;
+                s->match_ctx = cand;
+            }
+            cancel = (s->match <= offset);
+            pthread_mutex_unlock(&s->lock);
+
+            if (cancel)
+                break;
+            pos++;
+        }
+    }
+
+    free(buf);
+    return NULL;
+}
+
+///////////////////////////////////////////////////////////
+// fallback Disc ID search: SYSTEM.CNF data anywhere in the sector user data
+// (contiguous blocks scanned by several threads, the result is the candidate
+//  at the lowest offset, the same one a sequential scan would find)
+//
+// With a known logo magic1 the scan ends at the first candidate matching it.
+// magic1 is only 8 bits of the Disc ID, so it can't locate SYSTEM.CNF or
+// reject a Disc ID outright: the whole image is read only if no candidate
+// matches, and the first candidate is then kept (a logo made for another
+// Disc ID, reported by find_disc_id).
+//
+// args:    img: image handle
+//          ctx: image format, placeholder for the Disc ID
+//          logo_magic: magic1 of the encrypted logo (the scan stops at the
+//                      first candidate matching it), -1 if unknown
+//          threads: scan threads (0 = number of CPUs)
+//          found: placeholder for the image offset of the BOOT2 line
+// returns: true  if a Disc ID was found (the first matching candidate, else the first one)
+//          false if not found
+static bool scan_system_cnf(image_t *img, ps2m_ctx_t *ctx, int logo_magic, int threads, uint64_t *found)
+{
+    scan_t s = { .img = img, .ctx = ctx, .logo_magic = logo_magic, .next = 16, .match = UINT64_MAX, .first = UINT64_MAX };
+    pthread_t *tids;
+    uint32_t blocks;
+    int started = 0;
+
+    s.num_sectors = img->size / ctx->sector_size;
+    blocks = (s.num_sectors > 16) ? (s.num_sectors - 16 + SCAN_BLOCK_SECTORS - 1) / SCAN_BLOCK_SECTORS : 0;
+
+    if (threads <= 0)
+        threads = get_cpu_count();
+    if ((uint32_t)threads > blocks)
+        threads = blocks ? blocks : 1;
+
+    tids = calloc(threads, sizeof(pthread_t));
+    if (!tids)
+        return false;
+    pthread_mutex_init(&s.lock, NULL);
+
+    while (threads > 1 && started < threads && pthread_create(&tids[started], NULL, scan_worker, &s) == 0)
+        started++;
+
+    // single thread, or no scan thread started: scan from this one
+    if (!started)
+        scan_worker(&s);
+
+    for (int i = 0; i < started; i++)
+        pthread_join(tids[i], NULL);
+
+    pthread_mutex_destroy(&s.lock);
+    free(tids);
+
+    // no candidate matches the logo: keep the first one found
+    if (s.match != UINT64_MAX) {
+        *ctx = s.match_ctx;
+        *found = s.match;
+    } else if (s.first != UINT64_MAX) {
+        *ctx = s.first_ctx;
+        *found = s.first;
+    } else
+        return false;
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////
+// finds the Disc ID of an image: SYSTEM.CNF from the filesystem, else a scan
+// of the whole image (the encrypted logo magic1 narrows the scan down)
+//
+// args:    job: scan settings
+//          img: image handle
+//          ctx: image geometry, placeholder for the Disc ID
+//          boot: image boot area
+//          res: placeholder for the Disc ID / error message
+//          log: output stream for progress messages
+// returns: true  if ok
+//          false if no Disc ID was found
+static bool find_disc_id(const patch_job_t *job, image_t *img, ps2m_ctx_t *ctx, const uint8_t *boot, patch_result_t *res, FILE *log)
+{
+    uint64_t cnf_offset;
+    char cnf[ISO_BLOCK_SIZE];
+    uint32_t cnf_lba, cnf_size;
+    int logo_key;
+    uint8_t logo_magic = 0;
+
+    // An encrypted logo gives magic1 (8 bits of the Disc ID) without any search
+    logo_key = ps2m_logo_recover_magic(ctx, boot, &logo_magic);
+    if (logo_key == PS2M_LOGO_NTSC || logo_key == PS2M_LOGO_PAL)
+        fprintf(log, "[i] Encrypted PS2 logo (%s) uses magic1 0x%02X\n", (logo_key == PS2M_LOGO_PAL) ? "PAL" : "NTSC", logo_magic);
+    else
+        logo_key = 0;
+
+    fprintf(log, "[i] Searching for Disc ID in the image...\n");
+    if (iso9660_find_file(img, ctx, "SYSTEM.CNF", &cnf_lba, &cnf_size) ||
+        (ctx->disc_type == PS2M_DISC_DVD && udf_find_file(img, ctx, "SYSTEM.CNF", &cnf_lba, &cnf_size)))
+    {
+        fprintf(log, "    + Found SYSTEM.CNF file at LBA %u (%u bytes)\n", cnf_lba, cnf_size);
+        if (cnf_size > sizeof(cnf))
+            cnf_size = sizeof(cnf);
+
+        if (iso_read_block(img, ctx, cnf_lba, (uint8_t *)cnf))
+            ps2m_parse_system_cnf(ctx, cnf, cnf_size);
+    }
+
+    // Fallback: scan the image for SYSTEM.CNF data
+    // (with a known logo magic1, up to the first BOOT2 line matching it)
+    if (ctx->prod_num < 0)
+    {
+        fprintf(log, "    + Filesystem lookup failed, scanning the image...\n");
+        if (scan_system_cnf(img, ctx, logo_key ? logo_magic : -1, job->scan_threads, &cnf_offset))
+            fprintf(log, "    + Found SYSTEM.CNF data at offset 0x%" PRIX64 "\n", cnf_offset);
+    }
+
+    if (ctx->prod_num < 0) {
+        fprintf(log, "\n[!] Error! Could not detect Disc ID in the image.\n");
+        snprintf(res->message, sizeof(res->message), "Could not detect Disc ID");
+        return false;
+    }
+
+    fprintf(log, "    + Detected Disc ID: %s-%d (%s)\n", ctx->prod_code, ctx->prod_num, ctx->pal ? "PAL" : "NTSC");
+    if (logo_key && ctx->magic1 != logo_magic)
+        fprintf(log, "[!] Warning! Disc ID doesn't match the encrypted PS2 logo (magic1 0x%02X).\n", ctx->magic1);
+    snprintf(res->disc_id, sizeof(res->disc_id), "%s-%05d", ctx->prod_code, ctx->prod_num);
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////
+// patches a boot area in memory: adds the encrypted logo if the boot area is
+// empty, writes the master disc sectors and saves the original boot area in
+// the backup store
+//
+// args:    job: master disc sector settings
+//          ctx: image geometry and Disc ID
+//          boot: boot area to patch
+//          original: original boot area
+//          image_size: size of the image the boot area is written to
+//          res: placeholder for the error message
+//          log: output stream for progress messages
+// returns: 0 if ok
+//          -1 if error
+static int patch_boot_area(const patch_job_t *job, const ps2m_ctx_t *ctx, uint8_t *boot, const uint8_t *original,
+                           uint64_t image_size, patch_result_t *res, FILE *log)
+{
+    ps2m_master_info_t info;
+    char backup_dir[BACKUP_PATH_MAX];
+    char object[BACKUP_PATH_MAX + BACKUP_NAME_MAX];
+    int logo;
+
+    // Check if boot sector is empty
+    logo = ps2m_logo_status(ctx, boot);
+    if (logo == PS2M_LOGO_EMPTY)
+    {
+        fprintf(log, "[!] Disc image has an empty boot sector.\n");
+        fprintf(log, "    + Adding Encrypted PS2 logo (%s) to boot sector...\n", ctx->pal ? "PAL" : "NTSC");
+
+        if (!ps2m_logo_write(ctx, boot))
+            fprintf(log, "[!] Warning! Boot sectors are not CD-XA Mode 2 Form 1 sectors.\n");
+
+        logo = ps2m_logo_status(ctx, boot);
+    }
+
+    if (logo == PS2M_LOGO_NTSC || logo == PS2M_LOGO_PAL)
+        fprintf(log, "[i] Encrypted PS2 logo matches %s-%d\n", ctx->prod_code, ctx->prod_num);
+    else
+    {
+        fprintf(log, "[!] Warning! Disc doesn't seems to have a valid PS2 logo at the start.\n");
+        snprintf(res->message, sizeof(res->message), "No valid PS2 logo");
+    }
+
+    fprintf(log, "[i] Writing master disc sectors...\n");
+    // Create a PS2 master disc sector
+    info.region = job->region;
+    info.producer_name = job->producer_name;
+    info.copyright_holder = job->copyright_holder;
+    info.year = job->year;
+    info.month = job->month;
+    info.day = job->day;
+    info.cdvdgen_version = job->cdvdgen_version;
+
+    if (!ps2m_write_master_sectors(ctx, boot, &info)) {
+        fprintf(log, "\n[!] Error writing master disc sectors!\n\n");
+        snprintf(res->message, sizeof(res->message), "Error writing master disc sectors");
+        return -1;
+    }
+
+    // Save the original boot area before committing the patched one
+    fprintf(log, "[i] Backing up boot area...\n");
+    if (!backup_store_dir(backup_dir, sizeof(backup_dir)) ||
+        !backup_save(backup_dir, res->disc_id, image_size, original, boot, PS2M_BOOT_SECTORS * ctx->sector_size, object, sizeof(object))) {
+        fprintf(log, "\n[!] Error! Failed to save backup in '%s'\n\n", backup_dir);
+        snprintf(res->message, sizeof(res->message), "Failed to save backup");
+        return -1;
+    }
+    fprintf(log, "    + Saved to '%s'\n", object);
+
+    return 0;
+}
+
+static int patch_image_file(const patch_job_t *job, const char *path, patch_result_t *res, FILE *log)
+{
+    uint8_t *original;
+    image_t img;
+    uint8_t *boot;
+    ps2m_ctx_t ctx, probe;
+    ps2m_master_status_t master;
+    size_t boot_size;
+
+    memset(res, 0, sizeof(patch_result_t));
+    res->status = -1;
+    ps2m_init(&ctx);
+
+    fprintf(log, "[i] Reading '%s'...\n", path);
+    if (!image_open(&img, path, IMAGE_RDWR)) {
+        fprintf(log, "[!] Failed to open file!\n");
+        snprintf(res->message, sizeof(res->message), "Failed to open file");
+        return -1;
+    }
+
+    fprintf(log, "    + Image size: %" PRId64 " bytes\n", (int64_t)img.size);
+
+    if (!probe_image(&img, &ctx)) {
+        fprintf(log, "\n[!] Error! File doesn't seems to be a CD or DVD Image file.\n");
+        snprintf(res->message, sizeof(res->message), "Not a CD or DVD image");
+        image_close(&img);
+        return -1;
+    }
+    fprintf(log, "    + Detected %s Image (%u-byte sectors)\n", (ctx.disc_type == PS2M_DISC_DVD) ? "DVD-ROM" : "CD-ROM", ctx.sector_size);
+    res->disc_type = ctx.disc_type;
+
+    boot_size = PS2M_BOOT_SECTORS * ctx.sector_size;
+    boot = image_read_boot(&img, boot_size);
+    original = boot ? malloc(boot_size) : NULL;
+    if (!original) {
+        fprintf(log, "\n[!] Error! Could not read the image boot sectors.\n");
+        snprintf(res->message, sizeof(res->message), "Could not read boot sectors");
+        image_close(&img);
+        return -1;
+    }
+
+    // Keep the original boot area for the backup store
+    memcpy(original, boot, boot_size);
+
+    // Already patched with the same settings: nothing else to read or write
+    probe = ctx;
+    ps2m_inspect(&probe, boot, &master);
+    if (master_matches_job(&master, job))
+    {
+        fprintf(log, "[i] Image already has a valid master disc sector for %s, skipping.\n\n", master.disc_id);
+        snprintf(res->disc_id, sizeof(res->disc_id), "%s", master.disc_id);
+        snprintf(res->message, sizeof(res->message), "Already patched");
+        res->status = 0;
+        free(original);
+        image_close(&img);
+        return 0;
+    }
+
+    if (!find_disc_id(job, &img, &ctx, boot, res, log) ||
+        patch_boot_area(job, &ctx, boot, original, img.size, res, log) < 0) {
+        free(original);
+        image_close(&img);
+        return -1;
+    }
+
+    int result = image_commit_boot(&img) ? 0 : -1;
+
+    if(result < 0) {
+        fprintf(log, "\n[!] Error writing master disc sectors!\n\n");
+        snprintf(res->message, sizeof(res->message), "Error writing master disc sectors");
+    }
+    else
+        fprintf(log, "    + Master disc sectors written to '%s'\n\n", path);
+
+    free(original);
+    image_close(&img);
+
+    res->status = result;
+    return result;
+}
+
+///////////////////////////////////////////////////////////
+// patches a disc image with the master disc boot sectors
+// (in place, or on a copy of the image if an output path is set)
+//
+// args:    job: image path and master disc sector settings
+//          res: placeholder for the result summary
+//          log: output stream for progress messages
+// returns: 0 if ok
+//          -1 if error
+int patch_image(const patch_job_t *job, patch_result_t *res, FILE *log)
+{
+    const char *method = NULL;
+
+    if (!job->output_path)
+        return patch_image_file(job, job->path, res, log);
+
+    fprintf(log, "[i] Copying '%s' to '%s'...\n", job->path, job->output_path);
+    if (!image_clone(job->path, job->output_path, &method)) {
+        memset(res, 0, sizeof(patch_result_t));
+        res->status = -1;
+        fprintf(log, "[!] Failed to create '%s'\n", job->output_path);
+        snprintf(res->message, sizeof(res->message), "Failed to create output image");
+        return -1;
+    }
+    fprintf(log, "    + Image copied (%s)\n", method);
+
+    // don't leave an unpatched copy behind
+    if (patch_image_file(job, job->output_path, res, log) < 0) {
+        remove(job->output_path);
+        return -1;
+    }
+
+    return 0;
+}
+
+///////////////////////////////////////////////////////////
+// parses a region code letter
+//
+// args:    code: J/U/E/W (Japan/USA/Europe/World)
+//          region: placeholder for the region value
+// returns: true  if ok
+//          false if unknown code
+bool parse_region(const char *code, uint8_t *region)
+{
+    switch (code[0]) {
+        case 'J':
+        case 'j':
+            *region = PS2M_REGION_JAPAN;
+            return true;
+        case 'U':
+        case 'u':
+            *region = PS2M_REGION_USA;
+            return true;
+        case 'E':
+        case 'e':
+            *region = PS2M_REGION_EUROPE;
+            return true;
+        case 'W':
+        case 'w':
+            *region = PS2M_REGION_WORLD;
+            return true;
+        default:
+            return false;
+    }
+}
+
+const char* region_name(uint8_t region)
+{
+    switch (region) {
+        case PS2M_REGION_JAPAN:  return "Japan";
+        case PS2M_REGION_USA:    return "USA";
+        case PS2M_REGION_EUROPE: return "Europe";
+        case PS2M_REGION_WORLD:  return "World";
+        default:            return "None";
+    }
+}
+
+// Removes leading/trailing white space (in place)
+static char* trim(char *str)
+{
+    char *end;
+
+    while (isspace((unsigned char)*str))
+        str++;
+
+    end = str + strlen(str);
+    while (end > str && isspace((unsigned char)end[-1]))
+        *--end = 0;
+
+    return str;
+}
+
+// Appends a job for a copy of the image path (false if out of memory)
+static bool add_job(patch_job_t **jobs, int *count, const char *path, uint8_t region)
+{
+    patch_job_t *list = realloc(*jobs, (*count + 1) * sizeof(patch_job_t));
+    char *copy = strdup(path);
+
+    if (list)
+        *jobs = list;
+
+    if (!list || !copy) {
+        free(copy);
+        printf("[!] Out of memory\n");
+        return false;
+    }
+
+    set_job_defaults(&list[(*count)++], copy, region);
+    return true;
+}
+
+// Frees a job list and the paths it owns
+static void free_jobs(patch_job_t *jobs, int count)
+{
+    for (int i = 0; i < count; i++) {
+        free((char *)jobs[i].path);
+        free((char *)jobs[i].output_path);
+    }
+    free(jobs);
+}
+
+///////////////////////////////////////////////////////////
+// loads a batch manifest file
+//
+// each line describes one image, fields are comma separated and optional
+// except the path (empty fields keep the default values):
+//   path,region,producer name,copyright holder,YYYY-MM-DD,CDVDGEN version
+// lines starting with '#' are ignored
+//
+// args:    filename: manifest file path
+//          jobs: job list (grown as needed)
+//          count: number of jobs in the list
+//          region: default region
+// returns: true  if ok
+//          false if error (the jobs already added stay in the list)
+bool load_manifest(const char *filename, patch_job_t **jobs, int *count, uint8_t region)
+{
+    char line[1024];
+    int lineno = 0;
+    FILE *fp = fopen(filename, "r");
+
+    if (!fp) {
+        perror("Failed to open manifest");
+        return false;
+    }
+
+    while (fgets(line, sizeof(line), fp))
+    {
+        char *fields[6] = {0};
+        int nfields = 0;
+        char *str;
+        patch_job_t *job;
+
+        lineno++;
+        if (!strchr(line, '\n') && !feof(fp)) {
+            printf("[!] %s:%d: line too long (max %d characters)\n", filename, lineno, (int)sizeof(line) - 2);
+            fclose(fp);
+            return false;
+        }
+
+        str = trim(line);
+        if (!*str || *str == '#')
+            continue;
+
+        for (char *tok = str; tok && nfields < 6; nfields++)
+        {
+            fields[nfields] = tok;
+            tok = strchr(tok, ',');
+            if (tok)
+                *tok++ = 0;
+        }
+
+        if (!add_job(jobs, count, trim(fields[0]), region)) {
+            fclose(fp);
+            return false;
+        }
+        job = &(*jobs)[*count - 1];
+
+        if (fields[1] && *trim(fields[1]) && !parse_region(trim(fields[1]), &job->region)) {
+            printf("[!] %s:%d: unknown region code '%s'\n", filename, lineno, trim(fields[1]));
+            fclose(fp);
+            return false;
+        }
+        if (fields[2] && *trim(fields[2]))
+            snprintf(job->producer_name, sizeof(job->producer_name), "%s", trim(fields[2]));
+        if (fields[3] && *trim(fields[3]))
+            snprintf(job->copyright_holder, sizeof(job->copyright_holder), "%s", trim(fields[3]));
+        if (fields[4] && *trim(fields[4]) &&
+            sscanf(trim(fields[4]), "%d-%d-%d", &job->year, &job->month, &job->day) != 3) {
+            printf("[!] %s:%d: invalid date '%s' (expected YYYY-MM-DD)\n", filename, lineno, trim(fields[4]));
+            fclose(fp);
+            return false;
+        }
+        if (fields[5] && *trim(fields[5]))
+            snprintf(job->cdvdgen_version, sizeof(job->cdvdgen_version), "%s", trim(fields[5]));
+    }
+
+    fclose(fp);
+    return true;
+}
+
+typedef struct {
+    patch_job_t *jobs;
+    patch_result_t *results;
+    int count;
+    int next;
+    pthread_mutex_t lock;
+} batch_t;
+
+static void* batch_worker(void *arg)
+{
+    batch_t *batch = arg;
+    char *log_buf;
+    size_t log_len;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&batch->lock);
+        int i = batch->next++;
+        pthread_mutex_unlock(&batch->lock);
+
+        if (i >= batch->count)
+            break;
+
+        // keep each image log together
+        FILE *log = open_memstream(&log_buf, &log_len);
+        if (!log)
+            log = stdout;
+
+        patch_image(&batch->jobs[i], &batch->results[i], log);
+
+        if (log != stdout)
+        {
+            fclose(log);
+            pthread_mutex_lock(&batch->lock);
+            fwrite(log_buf, 1, log_len, stdout);
+            fflush(stdout);
+            pthread_mutex_unlock(&batch->lock);
+            free(log_buf);
+        }
+    }
+
+    return NULL;
+}
+
+///////////////////////////////////////////////////////////
+// patches a list of images using a thread pool
+//
+// args:    jobs: list of images to patch
+//          count: number of images
+//          threads: worker threads (0 = number of CPUs)
+//          summary_file: path of the result summary (NULL = stdout)
+// returns: number of images that failed
+int run_batch(patch_job_t *jobs, int count, int threads, const char *summary_file)
+{
+    batch_t batch = { .jobs = jobs, .count = count, .next = 0 };
+    pthread_t *tids;
+    FILE *summary = stdout;
+    int failed = 0, started = 0;
+
+    if (threads <= 0)
+        threads = get_cpu_count();
+    if (threads > count)
+        threads = count;
+
+    batch.results = calloc(count, sizeof(patch_result_t));
+    tids = calloc(threads, sizeof(pthread_t));
+    if (!batch.results || !tids) {
+        printf("[!] Out of memory\n");
+        free(batch.results);
+        free(tids);
+        return count;
+    }
+    pthread_mutex_init(&batch.lock, NULL);
+
+    // share the CPUs between the images being scanned at the same time
+    for (int i = 0; i < count; i++)
+        if (!jobs[i].scan_threads)
+            jobs[i].scan_threads = (get_cpu_count() > threads) ? get_cpu_count() / threads : 1;
+
+    printf("[i] Patching %d images using %d threads...\n\n", count, threads);
+    while (started < threads && pthread_create(&tids[started], NULL, batch_worker, &batch) == 0)
+        started++;
+
+    // no worker thread: patch the images from this one
+    if (!started)
+        batch_worker(&batch);
+
+    for (int i = 0; i < started; i++)
+        pthread_join(tids[i], NULL);
+
+    if (summary_file && !(summary = fopen(summary_file, "w"))) {
+        perror("Failed to open summary file");
+        summary = stdout;
+    }
+
+    fprintf(summary, "# status\tdisc id\ttype\timage\tmessage\n");
+    for (int i = 0; i < count; i++)
+    {
+        patch_result_t *res = &batch.results[i];
+
+        if (res->status < 0)
+            failed++;
+
+        fprintf(summary, "%s\t%s\t%s\t%s\t%s\n", res->status < 0 ? "FAIL" : "OK",
+                res->disc_id[0] ? res->disc_id : "-",
+                res->disc_type == PS2M_DISC_CD ? "CD" : (res->disc_type == PS2M_DISC_DVD ? "DVD" : "-"),
+                jobs[i].path, res->message);
+    }
+
+    if (summary != stdout) {
+        fclose(summary);
+        printf("[i] Result summary saved to '%s'\n", summary_file);
+    }
+    printf("[i] %d images patched, %d failed\n\n", count - failed, failed);
+
+    pthread_mutex_destroy(&batch.lock);
+    free(batch.results);
+    free(tids);
+
+    return failed;
+}
+
+#define VERIFY_CHUNK_SECTORS    1024    // sectors per work item (~2.3 MB)
+
+typedef struct {
+    uint32_t lba;
+    int flags;
+} bad_sector_t;
+
+typedef struct {
+    uint8_t *data;              // chunk buffer (NULL when the image is mapped)
+    const uint8_t *sectors;     // chunk sectors (in the mapping, or data)
+    int flags[VERIFY_CHUNK_SECTORS];
+    uint32_t count;
+} verify_slot_t;
+
+typedef struct {
+    image_t *img;
+    const ps2m_ctx_t *ctx;      // image geometry
+    uint32_t num_sectors;
+    verify_slot_t *slots;
+    uint32_t count[4];          // sectors of every type (PS2M_MODE_*)
+    bad_sector_t *bad;          // bad sectors in LBA order
+    uint32_t num_bad;
+    bool read_error, out_of_memory;
+} verify_t;
+
+// Reader: maps or reads consecutive chunks of the image
+static void verify_read(void *arg, int s, uint32_t c)
+{
+    verify_t *v = arg;
+    verify_slot_t *slot = &v->slots[s];
+    uint32_t sector_size = v->ctx->sector_size;
+    uint32_t start = c * VERIFY_CHUNK_SECTORS;
+
+    slot->count = v->num_sectors - start;
+    if (slot->count > VERIFY_CHUNK_SECTORS)
+        slot->count = VERIFY_CHUNK_SECTORS;
+
+    slot->sectors = image_view(v->img, (uint64_t)start * sector_size, (size_t)slot->count * sector_size, slot->data);
+    if (!slot->sectors)
+    {
+        // nothing will be checked for this chunk
+        v->read_error = true;
+        slot->count = 0;
+    }
+}
+
+// Worker: checks sync/header/EDC/ECC of every sector of a chunk
+static void verify_work(void *arg, int s, uint32_t c)
+{
+    verify_t *v = arg;
+    verify_slot_t *slot = &v->slots[s];
+
+    ps2m_sectors_check(v->ctx, slot->sectors, slot->count, c * VERIFY_CHUNK_SECTORS, slot->flags);
+}
+
+// Writer: counts the sectors and collects the bad ones in LBA order
+static void verify_write(void *arg, int s, uint32_t c)
+{
+    verify_t *v = arg;
+    verify_slot_t *slot = &v->slots[s];
+
+    for (uint32_t i = 0; i < slot->count; i++)
+    {
+        int flags = slot->flags[i];
+        int type = (flags & PS2M_SECTOR_SKIPPED) ? PS2M_MODE_NONE :
+                   (flags & PS2M_SECTOR_MODE1) ? PS2M_MODE1 :
+                   (flags & PS2M_SECTOR_FORM2) ? PS2M_MODE2_FORM2 : PS2M_MODE2_FORM1;
+
+        v->count[type]++;
+        if (type == PS2M_MODE_NONE || !(flags & ~(PS2M_SECTOR_MODE1 | PS2M_SECTOR_FORM2)))
+            continue;
+
+        bad_sector_t *bad = realloc(v->bad, (v->num_bad + 1) * sizeof(bad_sector_t));
+
+        if (!bad) {
+            v->out_of_memory = true;
+            continue;
+        }
+
+        v->bad = bad;
+        v->bad[v->num_bad].lba = c * VERIFY_CHUNK_SECTORS + i;
+        v->bad[v->num_bad].flags = flags;
+        v->num_bad++;
+    }
+}
+
+static double get_time(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+///////////////////////////////////////////////////////////
+// verifies the EDC/ECC data of every sector in a CD image
+// (reader -> worker pool -> ordered writer, the image is opened read-only)
+//
+// args:    path: CD image (.BIN) path
+//          threads: worker threads (0 = number of CPUs)
+// returns: 0 if all sectors are intact
+//          -1 if error or bad sectors were found
+int verify_image(const char *path, int threads)
+{
+    verify_t v;
+    image_t img;
+    ps2m_ctx_t ctx;
+    pipeline_t p;
+    uint8_t msf[3];
+    double start, elapsed;
+    int ret = -1;
+
+    printf("[i] Reading '%s'...\n", path);
+    if (!image_open(&img, path, IMAGE_RDONLY)) {
+        perror("Failed to open file!");
+        return -1;
+    }
+
+    ps2m_init(&ctx);
+    if (!probe_image(&img, &ctx) || !ctx.edc_ecc) {
+        printf("\n[!] Error! File doesn't seems to be a CD Image file.\n");
+        image_close(&img);
+        return -1;
+    }
+
+    if (threads <= 0)
+        threads = get_cpu_count();
+
+    memset(&v, 0, sizeof(v));
+    v.img = &img;
+    v.ctx = &ctx;
+    v.num_sectors = ctx.num_sectors;
+
+    memset(&p, 0, sizeof(p));
+    p.arg = &v;
+    p.num_chunks = (v.num_sectors + VERIFY_CHUNK_SECTORS - 1) / VERIFY_CHUNK_SECTORS;
+    p.num_slots = threads * 2 + 2;
+    p.threads = threads;
+    p.read = verify_read;
+    p.work = verify_work;
+    p.write = verify_write;
+
+    // mapped images are checked in place, otherwise every slot reads its chunk
+    v.slots = calloc(p.num_slots, sizeof(verify_slot_t));
+    for (int i = 0; v.slots && !img.map && i < p.num_slots; i++)
+        if (!(v.slots[i].data = malloc(VERIFY_CHUNK_SECTORS * ctx.sector_size)))
+            break;
+
+    if (!v.slots || (!img.map && !v.slots[p.num_slots - 1].data)) {
+        printf("[!] Out of memory\n");
+        goto cleanup;
+    }
+
+    printf("[i] Verifying %u sectors using %d threads...\n", v.num_sectors, threads);
+    start = get_time();
+
+    if (!pipeline_run(&p)) {
+        printf("[!] Error! Could not start the worker threads.\n\n");
+        goto cleanup;
+    }
+
+    elapsed = get_time() - start;
+
+    for (uint32_t i = 0; i < v.num_bad; i++)
+    {
+        int flags = v.bad[i].flags;
+
+        ps2m_lba_to_msf(v.bad[i].lba, msf);
+        printf("    + Bad sector at %02X:%02X:%02X (LBA %u):%s%s%s%s%s\n", msf[0], msf[1], msf[2], v.bad[i].lba,
+            (flags & PS2M_SECTOR_BAD_SYNC) ? " sync" : "",
+            (flags & PS2M_SECTOR_BAD_ADDRESS) ? " address" : "",
+            (flags & PS2M_SECTOR_BAD_SUBHEADER) ? " subheader" : "",
+            (flags & PS2M_SECTOR_BAD_EDC) ? " EDC" : "",
+            (flags & PS2M_SECTOR_BAD_ECC) ? " ECC" : "");
+    }
+
+    printf("[i] %u Mode 1, %u Form 1 and %u Form 2 sectors checked, %u skipped (Mode 0 or no data sync/header)\n",
+        v.count[PS2M_MODE1], v.count[PS2M_MODE2_FORM1], v.count[PS2M_MODE2_FORM2], v.count[PS2M_MODE_NONE]);
+    printf("    + %u bad sectors found\n", v.num_bad);
+    printf("    + %.2f s, %.1f MB/s (%.0f sectors/s)\n\n", elapsed,
+        elapsed > 0 ? img.size / elapsed / (1024 * 1024) : 0.0,
+        elapsed > 0 ? v.num_sectors / elapsed : 0.0);
+
+    if (v.read_error || v.out_of_memory)
+        printf("[!] Error! Could not %s.\n\n", v.read_error ? "read some sectors" : "list all the bad sectors (out of memory)");
+    else if (!v.num_bad)
+        ret = 0;
+
+cleanup:
+    for (int i = 0; v.slots && i < p.num_slots; i++)
+        free(v.slots[i].data);
+    free(v.slots);
+    free(v.bad);
+    image_close(&img);
+
+    return ret;
+}
+
+#define REPAIR_CHUNK_SECTORS    1024    // sectors per work item (~2.3 MB)
+
+typedef struct {
+    uint8_t *data;
+    int flags[REPAIR_CHUNK_SECTORS];
+    uint32_t count;
+} repair_slot_t;
+
+typedef struct {
+    image_t *img;
+    const ps2m_ctx_t *ctx;      // image geometry
+    uint32_t num_sectors;
+    repair_slot_t *slots;
+    uint32_t count[4];          // sectors of every type (PS2M_MODE_*)
+    uint32_t fixed[4];          // repaired sectors of every type
+    uint32_t written;
+    bool read_error, write_error;
+} repair_t;
+
+// Reader: reads consecutive chunks of the image
+static void repair_read(void *arg, int s, uint32_t c)
+{
+    repair_t *r = arg;
+    repair_slot_t *slot = &r->slots[s];
+    uint32_t sector_size = r->ctx->sector_size;
+    uint32_t start = c * REPAIR_CHUNK_SECTORS;
+
+    slot->count = r->num_sectors - start;
+    if (slot->count > REPAIR_CHUNK_SECTORS)
+        slot->count = REPAIR_CHUNK_SECTORS;
+
+    if (!image_read(r->img, (uint64_t)start * sector_size, slot->data, (size_t)slot->count * sector_size))
+    {
+        // nothing will be written for this chunk
+        r->read_error = true;
+        slot->count = 0;
+    }
+}
+
+// Worker: regenerates sync/EDC/ECC and flags the sectors that changed
+static void repair_work(void *arg, int s, uint32_t c)
+{
+    repair_t *r = arg;
+    repair_slot_t *slot = &r->slots[s];
+
+    ps2m_sectors_fix(r->ctx, slot->data, slot->count, c * REPAIR_CHUNK_SECTORS, slot->flags);
+}
+
+// Writer: counts the sectors, rewrites changed ones in image order (one write per run of sectors)
+static void repair_write(void *arg, int s, uint32_t c)
+{
+    repair_t *r = arg;
+    repair_slot_t *slot = &r->slots[s];
+    uint32_t sector_size = r->ctx->sector_size;
+    uint32_t base = c * REPAIR_CHUNK_SECTORS;
+    uint8_t msf[2][3];
+
+    for (uint32_t i = 0; i < slot->count; i++)
+    {
+        int flags = slot->flags[i];
+        int type = (flags & PS2M_SECTOR_SKIPPED) ? PS2M_MODE_NONE :
+                   (flags & PS2M_SECTOR_MODE1) ? PS2M_MODE1 :
+                   (flags & PS2M_SECTOR_FORM2) ? PS2M_MODE2_FORM2 : PS2M_MODE2_FORM1;
+
+        r->count[type]++;
+        if (flags & PS2M_SECTOR_FIXED)
+            r->fixed[type]++;
+    }
+
+    for (uint32_t i = 0; i < slot->count; i++)
+    {
+        uint32_t n = 0;
+
+        while (i + n < slot->count && (slot->flags[i + n] & PS2M_SECTOR_FIXED))
+            n++;
+
+        if (!n)
+            continue;
+
+        if (!image_write(r->img, (uint64_t)(base + i) * sector_size, slot->data + (size_t)i * sector_size, (size_t)n * sector_size))
+            r->write_error = true;
+
+        ps2m_lba_to_msf(base + i, msf[0]);
+        ps2m_lba_to_msf(base + i + n - 1, msf[1]);
+        printf("    + Rewrote %02X:%02X:%02X-%02X:%02X:%02X (LBA %u-%u)\n",
+            msf[0][0], msf[0][1], msf[0][2], msf[1][0], msf[1][1], msf[1][2], base + i, base + i + n - 1);
+
+        r->written += n;
+        i += n;
+    }
+}
+
+///////////////////////////////////////////////////////////
+// regenerates the sync/EDC/ECC data of every Mode 1 / Mode 2 sector in a CD image
+// (reader -> worker pool -> ordered writer, only changed sectors are written)
+//
+// args:    path: CD image (.BIN) path
+//          threads: worker threads (0 = number of CPUs)
+// returns: 0 if ok
+//          -1 if error
+int repair_image(const char *path, int threads)
+{
+    repair_t r;
+    image_t img;
+    ps2m_ctx_t ctx;
+    pipeline_t p;
+    double start, elapsed;
+    int ret = -1;
+
+    printf("[i] Reading '%s'...\n", path);
+    if (!image_open(&img, path, IMAGE_RDWR)) {
+        perror("Failed to open file!");
+        return -1;
+    }
+
+    ps2m_init(&ctx);
+    if (!probe_image(&img, &ctx) || !ctx.edc_ecc) {
+        printf("\n[!] Error! File doesn't seems to be a CD Image file.\n");
+        image_close(&img);
+        return -1;
+    }
+
+    if (threads <= 0)
+        threads = get_cpu_count();
+
+    memset(&r, 0, sizeof(r));
+    r.img = &img;
+    r.ctx = &ctx;
+    r.num_sectors = ctx.num_sectors;
+
+    memset(&p, 0, sizeof(p));
+    p.arg = &r;
+    p.num_chunks = (r.num_sectors + REPAIR_CHUNK_SECTORS - 1) / REPAIR_CHUNK_SECTORS;
+    p.num_slots = threads * 2 + 2;
+    p.threads = threads;
+    p.read = repair_read;
+    p.work = repair_work;
+    p.write = repair_write;
+
+    r.slots = calloc(p.num_slots, sizeof(repair_slot_t));
+    for (int i = 0; r.slots && i < p.num_slots; i++)
+        if (!(r.slots[i].data = malloc(REPAIR_CHUNK_SECTORS * ctx.sector_size)))
+            break;
+
+    if (!r.slots || !r.slots[p.num_slots - 1].data) {
+        printf("[!] Out of memory\n");
+        goto cleanup;
+    }
+
+    printf("[i] Repairing %u sectors using %d threads...\n", r.num_sectors, threads);
+    start = get_time();
+
+    if (!pipeline_run(&p)) {
+        printf("[!] Error! Could not start the worker threads.\n\n");
+        goto cleanup;
+    }
+
+    elapsed = get_time() - start;
+
+    printf("[i] %u Mode 1, %u Form 1 and %u Form 2 sectors checked, %u skipped (Mode 0 or no data sync/header)\n",
+        r.count[PS2M_MODE1], r.count[PS2M_MODE2_FORM1], r.count[PS2M_MODE2_FORM2], r.count[PS2M_MODE_NONE]);
+    printf("    + %u Mode 1, %u Form 1 and %u Form 2 sectors repaired (%u written)\n",
+        r.fixed[PS2M_MODE1], r.fixed[PS2M_MODE2_FORM1], r.fixed[PS2M_MODE2_FORM2], r.written);
+    printf("    + %.2f s, %.1f MB/s (%.0f sectors/s)\n\n", elapsed,
+        elapsed > 0 ? img.size / elapsed / (1024 * 1024) : 0.0,
+        elapsed > 0 ? r.num_sectors / elapsed : 0.0);
+
+    if (r.read_error || r.write_error)
+        printf("[!] Error! Could not %s some sectors.\n\n", r.read_error ? "read" : "write");
+    else
+        ret = 0;
+
+cleanup:
+    for (int i = 0; r.slots && i < p.num_slots; i++)
+        free(r.slots[i].data);
+    free(r.slots);
+    image_close(&img);
+
+    return ret;
+}
+
+#define CONVERT_CHUNK_SECTORS   1024    // sectors per work item (~2.3 MB of raw sectors)
+#define CD_MAX_SECTORS          360000  // 80 minutes CD-R
+
+typedef struct {
+    uint8_t *in;
+    uint8_t *out;
+    int flags[CONVERT_CHUNK_SECTORS];
+    uint32_t count;
+} convert_slot_t;
+
+typedef struct {
+    image_t *img;
+    image_t *out;
+    const ps2m_ctx_t *ctx;      // input image geometry
+    const ps2m_ctx_t *out_ctx;  // output image geometry
+    const patch_job_t *job;     // master disc sector settings (NULL = no patch)
+    patch_result_t *res;
+    uint8_t *original;          // unpatched output boot area (backup)
+    bool to_iso;                // BIN -> ISO, else ISO -> BIN
+    uint32_t num_sectors;
+    convert_slot_t *slots;
+    uint32_t count[4];          // sectors of every type (PS2M_MODE_*)
+    bool read_error, write_error, patch_error;
+} convert_t;
+
+// Reader: reads consecutive chunks of the input image
+static void convert_read(void *arg, int s, uint32_t c)
+{
+    convert_t *cv = arg;
+    convert_slot_t *slot = &cv->slots[s];
+    uint32_t sector_size = cv->ctx->sector_size;
+    uint32_t start = c * CONVERT_CHUNK_SECTORS;
+
+    slot->count = cv->num_sectors - start;
+    if (slot->count > CONVERT_CHUNK_SECTORS)
+        slot->count = CONVERT_CHUNK_SECTORS;
+
+    if (!image_read(cv->img, (uint64_t)start * sector_size, slot->in, (size_t)slot->count * sector_size))
+    {
+        cv->read_error = true;
+        memset(slot->in, 0, (size_t)slot->count * sector_size);
+    }
+}
+
+// Worker: builds the output sectors of a chunk (raw sectors with EDC/ECC, or ISO sectors)
+static void convert_work(void *arg, int s, uint32_t c)
+{
+    convert_t *cv = arg;
+    convert_slot_t *slot = &cv->slots[s];
+
+    if (cv->to_iso)
+        ps2m_sectors_to_iso(cv->ctx, slot->out, slot->in, slot->count, c * CONVERT_CHUNK_SECTORS, slot->flags);
+    else
+        ps2m_sectors_from_iso(slot->out, slot->in, slot->count, c * CONVERT_CHUNK_SECTORS);
+}
+
+// Writer: writes the chunks in image order, the master disc patch goes into the first one
+// (after a failed patch the remaining chunks are only drained)
+static void convert_write(void *arg, int s, uint32_t c)
+{
+    convert_t *cv = arg;
+    convert_slot_t *slot = &cv->slots[s];
+    uint32_t out_size = cv->out_ctx->sector_size;
+
+    for (uint32_t i = 0; i < slot->count; i++)
+    {
+        int flags = cv->to_iso ? slot->flags[i] : 0;
 
-#include "wildcard.h"
-#include "lzari.h"
-#include "cdrom.h"
+        cv->count[(flags & PS2M_SECTOR_SKIPPED) ? PS2M_MODE_NONE :
+                  (flags & PS2M_SECTOR_MODE1) ? PS2M_MODE1 :
+                  (flags & PS2M_SECTOR_FORM2) ? PS2M_MODE2_FORM2 : PS2M_MODE2_FORM1]++;
+    }
 
-#include "logo_ntsc.h"
-#include "logo_pal.h"
+    if (c == 0 && cv->job)
+    {
+        memcpy(cv->original, slot->out, PS2M_BOOT_SECTORS * out_size);
+        if (patch_boot_area(cv->job, cv->out_ctx, slot->out, cv->original, cv->out->size, cv->res, stdout) < 0)
+            cv->patch_error = true;
+    }
 
+    if (!cv->patch_error && !image_write(cv->out, (uint64_t)c * CONVERT_CHUNK_SECTORS * out_size, slot->out, (size_t)slot->count * out_size))
+        cv->write_error = true;
+}
 
-#pragma pack(push, 1)
-typedef struct {
-    // Header section
-    char disc_name[32];
-    char producer_name[32];
-    char copyright_holder[32];
-    uint32_t year_bcd;
-    uint16_t month_bcd;
-    uint16_t day_bcd;
-    char master_disc_text[24];  // "PlayStation Master Disc "
-    uint8_t playstation_version;
-    uint8_t region;
-    uint8_t reserved1;
-    uint8_t disc_type;
-    
-    union {
-        // CD format
-        struct {
-            char cd_filler[124];
-        } cd;
-        
-        // DVD format
-        struct {
-            uint8_t dvd_byte1;
-            uint8_t dvd_byte2;
-            uint32_t sector_count_adjusted;
-            uint32_t dvd_reserved;
-            char dvd_filler[114];
-        } dvd;
-    } media_specific;
-    
-    // Common section
-    uint8_t common_byte1;
-    uint64_t common_ff;
-    uint32_t magic2_first;
-    uint8_t magic1_first;
-    uint16_t reserved2;
-    uint8_t section1_byte1;
-    uint32_t section1_value1;
-    uint32_t section1_value2;
-    uint32_t magic2_second;
-    uint8_t magic1_second;
-    uint16_t reserved3;
-    uint8_t section2_byte1;
-    uint32_t section2_value1;
-    uint32_t section2_value2;
-    uint32_t zeros1;
-    uint8_t magic3;
-    uint16_t reserved4;
-    uint32_t zeros2;
-    uint32_t zeros3;
-    uint32_t zeros4;
-    uint32_t zeros5;
-    char zeros_large[448];
-    char spaces1[48];
-    char cdvdgen_text[16];
-    char spaces2[1216];
-} MasterDiscSector;
-#pragma pack(pop)
-
-#pragma pack(push, 1)
-typedef struct {
-    // Disc identification section
-    char disc_name[32];           // Offset 0
-    char producer_name[32];       // Offset 32
-    char copyright_holder[32];    // Offset 64
-    
-    // Date information (BCD format)
-    uint32_t year_bcd;            // Offset 96
-    uint16_t month_bcd;           // Offset 100
-    uint16_t day_bcd;             // Offset 102
-    
-    // Master disc identifier
-    char master_disc[24];         // Offset 104
-    
-    // System information
-    uint8_t playstation_version;  // Offset 128
-    uint8_t region;               // Offset 129
-    uint8_t reserved1;            // Offset 130
-    uint8_t disc_type;            // Offset 131
-    
-    // Disc-specific data (union for CD/DVD)
-    union {
-        struct {
-            char cd_filler[124]; // Offset 132
-        } cd;
-        struct {
-            uint8_t dvd_byte1; // Offset 132
-            uint8_t dvd_byte2; // Offset 133
-            uint32_t sector_count_adjusted; // Offset 134
-            uint32_t dvd_reserved; // Offset 138
-            char dvd_filler[114];   // Offset 142
-        } dvd;
-    } media_specific;
-    
-    // Various system fields
-    uint8_t common_byte1;         // Offset 256
-    uint64_t common_ff1;          // Offset 257
-    uint32_t magic2_first;        // Offset 265
-    uint8_t magic1_first;         // Offset 269
-    uint16_t field_270;           // Offset 270
-    uint8_t field_272;            // Offset 272
-    uint64_t common_ff2;          // Offset 273
-    uint32_t field_281;           // Offset 281
-    uint8_t field_285;            // Offset 285
-    uint16_t field_286;           // Offset 286
-    uint8_t field_288;            // Offset 288
-    uint32_t field_289;           // Offset 289
-    uint32_t field_293;           // Offset 293
-    uint32_t magic2_second;       // Offset 297
-    uint8_t magic1_second;        // Offset 301
-    uint16_t field_302;           // Offset 302
-    uint8_t field_304;            // Offset 304
-    uint32_t field_305;           // Offset 305
-    uint32_t field_309;           // Offset 309
-    uint32_t field_313;           // Offset 313
-    uint8_t magic3;               // Offset 317
-    uint8_t field_318;            // Offset 318
-    uint8_t field_319;            // Offset 319
-    
-    // Padding sections
-    uint8_t zeros_large[448];     // Offset 320
-    char spaces1[48];             // Offset 768
-    char cdvdgen_version[16];     // Offset 816
-    char spaces2[1216];           // Offset 828
-} JapanMasterDiscSector;
-#pragma pack(pop)
-
-enum {
-    REGION_NONE = 0x00,
-    REGION_JAPAN = 0x01,
-    REGION_USA = 0x02,
-    REGION_EUROPE = 0x04,
-    REGION_WORLD = 0x07,
-};
-
-enum {
-    DISC_NONE = 0,
-    DISC_CD   = 1,
-    DISC_DVD  = 2,
-};
-
-// The notes mention BCD format for date fields, but samples show a different encoding (text)
-uint16_t int_to_bcd(int value)
-{
-    return (((value % 10) + 0x30) << 8) | ((value / 10) + 0x30);
-//    return ((value / 10) << 4) | (value % 10);
-}
-
-// Helper function to pad string with spaces
-void pad_string(char *dest, const char *src, size_t length)
-{
-    strncpy(dest, src, length);
-    for (size_t i = strlen(src); i < length; i++) {
-        dest[i] = ' ';
-    }
-}
-
-/* This is the basic CRC-32 calculation with some optimization but no table lookup. */
-uint32_t crc32b(uint8_t *data, size_t size)
-{
-	uint32_t crc = 0xFFFFFFFF;
-
-	while (size--){
-		crc ^= *data++;          // XOR with next byte.
-		for (int j=0; j<8; j++){     // Do eight times.
-			crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
-		}
-	}
-	return ~crc;
-}
-
-bool fixMode2Form1Sector(FILE* inputfile, int sector_index)
-{
-    //Sync pattern
-    unsigned char sync[SYNC_SIZE] = {0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00};
-    unsigned char sector[SECTOR_SIZE];
-
-    //Read sector
-    fseek(inputfile, sector_index * SECTOR_SIZE, SEEK_SET);
-    if(fread(sector, 1, SECTOR_SIZE, inputfile) != SECTOR_SIZE)
-        return false;
+///////////////////////////////////////////////////////////
+// converts a 2048-byte ISO image to a raw CD image (Mode 2 Form 1 sectors
+// with EDC/ECC), or a CD image to a 2048-byte ISO image
+// (reader -> worker pool -> ordered writer, with a bounded number of chunks
+//  in flight; the master disc patch is applied to the first chunk on its way
+//  to the output, so the input is read only once)
+//
+// args:    path: input image path
+//          output_path: output image path
+//          job: master disc sector settings (NULL = no patch)
+//          threads: worker threads (0 = number of CPUs)
+// returns: 0 if ok
+//          -1 if error
+int convert_image(const char *path, const char *output_path, const patch_job_t *job, int threads)
+{
+    convert_t cv;
+    image_t img, out;
+    ps2m_ctx_t ctx, out_ctx;
+    patch_result_t res;
+    pipeline_t p;
+    struct stat in_st, out_st;
+    uint8_t *boot = NULL;
+    uint32_t out_size;
+    bool created = false;
+    double start, elapsed;
+    int ret = -1;
+
+    printf("[i] Reading '%s'...\n", path);
+    if (!image_open(&img, path, IMAGE_RDONLY)) {
+        perror("Failed to open file!");
+        return -1;
+    }
 
-    //Find mode
-    unsigned char minutes = sector[HEADER_OFFSET + 0];
-    unsigned char seconds = sector[HEADER_OFFSET + 1];
-    unsigned char blocks  = sector[HEADER_OFFSET + 2];
-    unsigned char mode    = sector[HEADER_OFFSET + 3];
-    if (mode != MODE_2)
+    ps2m_init(&ctx);
+    if (!probe_image(&img, &ctx) || (!ctx.edc_ecc && ctx.sector_size != PS2M_DVD_SECTOR_SIZE)) {
+        printf("\n[!] Error! File doesn't seems to be a CD or ISO Image file.\n");
+        image_close(&img);
+        return -1;
+    }
+
+    if (threads <= 0)
+        threads = get_cpu_count();
+
+    memset(&cv, 0, sizeof(cv));
+    cv.img = &img;
+    cv.out = &out;
+    cv.ctx = &ctx;
+    cv.out_ctx = &out_ctx;
+    cv.job = job;
+    cv.res = &res;
+    cv.to_iso = ctx.edc_ecc;
+    cv.num_sectors = ctx.num_sectors;
+
+    memset(&p, 0, sizeof(p));
+    p.arg = &cv;
+    p.num_chunks = (cv.num_sectors + CONVERT_CHUNK_SECTORS - 1) / CONVERT_CHUNK_SECTORS;
+    p.num_slots = threads * 2 + 2;
+    p.threads = threads;
+    p.read = convert_read;
+    p.work = convert_work;
+    p.write = convert_write;
+
+    out_size = cv.to_iso ? PS2M_DVD_SECTOR_SIZE : PS2M_CD_SECTOR_SIZE;
+    printf("    + Converting %u %u-byte sectors to %s (%u-byte sectors)\n", cv.num_sectors, ctx.sector_size,
+        cv.to_iso ? "ISO" : "BIN", out_size);
+
+    if (!cv.to_iso && cv.num_sectors > CD_MAX_SECTORS)
+        printf("[!] Warning! %u sectors don't fit on a 80 minutes CD.\n", cv.num_sectors);
+
+    // The Disc ID comes from the input image, the patched boot area is the output one
+    if (job)
     {
-        printf("Error: Only CD-XA Mode 2 sectors are supported. Found mode %d sector at %02X:%02X:%02X\n", mode, minutes, seconds, blocks);
-        return false;
+        memset(&res, 0, sizeof(res));
+        boot = malloc(PS2M_BOOT_SECTORS * ctx.sector_size);
+        cv.original = malloc(PS2M_BOOT_SECTORS * out_size);
+
+        if (!boot || !cv.original || cv.num_sectors < PS2M_BOOT_SECTORS ||
+            !image_read(&img, 0, boot, PS2M_BOOT_SECTORS * ctx.sector_size)) {
+            printf("\n[!] Error! Could not read the image boot sectors.\n");
+            goto cleanup;
+        }
+
+        if (!find_disc_id(job, &img, &ctx, boot, &res, stdout))
+            goto cleanup;
     }
 
-    //Process sector based on mode 2 form 1
-    //Write sync field
-    memcpy(sector, sync, sizeof(sync));
+    out_ctx = ctx;
+    ps2m_set_format(&out_ctx, cv.to_iso ? PS2M_DISC_DVD : PS2M_DISC_CD, out_size, cv.num_sectors);
 
-    //Read subheader
-    unsigned char submode           = sector[CDROMXA_SUBHEADER_OFFSET + 2];
+    // never truncate the input image
+    if (stat(output_path, &out_st) == 0 && stat(path, &in_st) == 0 &&
+        in_st.st_dev == out_st.st_dev && in_st.st_ino == out_st.st_ino) {
+        printf("\n[!] Error! The output image can't be the input image.\n\n");
+        goto cleanup;
+    }
 
-    //Check that the two copies of the subheader data are equivalent
-    if(memcmp(&sector[CDROMXA_SUBHEADER_OFFSET + 0], &sector[CDROMXA_SUBHEADER_OFFSET + 4], 4) != 0)
-    {
-        printf("[!] Warning: CD-ROM XA subheader mismatch at %02X:%02X:%02X\n", minutes, seconds, blocks);
+    if (!image_create(&out, output_path, (uint64_t)cv.num_sectors * out_size)) {
+        printf("[!] Failed to create '%s'\n", output_path);
+        goto cleanup;
     }
+    created = true;
 
-    //Determine CD ROM XA Mode 2 form
-    if ((submode & 0x20) == 0x20)
-    {
-        printf("[!] Error: Only CD-XA Mode 2 Form 1 sectors are supported. Found CD-XA Mode 2 Form 2 sector at %02X:%02X:%02X\n", minutes, seconds, blocks);
-        return false;
+    cv.slots = calloc(p.num_slots, sizeof(convert_slot_t));
+    for (int i = 0; cv.slots && i < p.num_slots; i++)
+        if (!(cv.slots[i].in = malloc(CONVERT_CHUNK_SECTORS * ctx.sector_size)) ||
+            !(cv.slots[i].out = malloc(CONVERT_CHUNK_SECTORS * out_size)))
+            break;
+
+    if (!cv.slots || !cv.slots[p.num_slots - 1].out) {
+        printf("[!] Out of memory\n");
+        goto cleanup;
     }
 
-    //Compute and write EDC
-    //Compute form 1 EDC
-    unsigned int EDC = 0x00000000;
-    for(int i = CDROMXA_SUBHEADER_OFFSET; i < CDROMXA_FORM1_EDC_OFFSET; ++i)
-    {
-        EDC = EDC ^ sector[i];
-        EDC = (EDC >> 8) ^ EDCTable[EDC & 0x000000FF];
+    printf("[i] Converting to '%s' using %d threads...\n", output_path, threads);
+    start = get_time();
+
+    if (!pipeline_run(&p)) {
+        printf("[!] Error! Could not start the worker threads.\n\n");
+        goto cleanup;
     }
 
-    //Write EDC
-    sector[CDROMXA_FORM1_EDC_OFFSET + 0] = (EDC & 0x000000FF) >> 0;
-    sector[CDROMXA_FORM1_EDC_OFFSET + 1] = (EDC & 0x0000FF00) >> 8;
-    sector[CDROMXA_FORM1_EDC_OFFSET + 2] = (EDC & 0x00FF0000) >> 16;
-    sector[CDROMXA_FORM1_EDC_OFFSET + 3] = (EDC & 0xFF000000) >> 24;
+    elapsed = get_time() - start;
 
-    //Write error-correction data
+    if (cv.to_iso)
+    {
+        printf("[i] %u Mode 1, %u Form 1 and %u Form 2 sectors converted, %u Mode 0 or non-data\n",
+            cv.count[PS2M_MODE1], cv.count[PS2M_MODE2_FORM1], cv.count[PS2M_MODE2_FORM2], cv.count[PS2M_MODE_NONE]);
+        if (cv.count[PS2M_MODE2_FORM2])
+            printf("[!] Warning! %u Form 2 sectors were cut to 2048 bytes of user data.\n", cv.count[PS2M_MODE2_FORM2]);
+    }
+    else
+        printf("[i] %u Form 1 sectors built\n", cv.count[PS2M_MODE2_FORM1]);
 
-    //Temporarily clear header
-    memset(&sector[HEADER_OFFSET], 0, 4);
+    printf("    + %.2f s, %.1f MB/s (%.0f sectors/s)\n\n", elapsed,
+        elapsed > 0 ? img.size / elapsed / (1024 * 1024) : 0.0,
+        elapsed > 0 ? cv.num_sectors / elapsed : 0.0);
 
-    //Calculate P parity
-    unsigned char* src = sector + HEADER_OFFSET;
-    unsigned char* dst = sector + CDROMXA_FORM1_PARITY_P_OFFSET;
-    for(int i = 0; i < 43; ++i)
+    if (cv.read_error || cv.write_error)
+        printf("[!] Error! Could not %s some sectors.\n\n", cv.read_error ? "read" : "write");
+    else if (!cv.patch_error)
     {
-        unsigned short x = 0x0000;
-        unsigned short y = 0x0000;
-        for(int j = 19; j < 43; ++j)
-        {
-            x ^= RSPCTable[j][src[0]]; //LSB
-            y ^= RSPCTable[j][src[1]]; //MSB
-            src += 2 * 43;
-        }
-        dst[         0] = x >> 8;
-        dst[2 * 43 + 0] = x & 0xFF;
-        dst[         1] = y >> 8;
-        dst[2 * 43 + 1] = y & 0xFF;
-        dst += 2;
-        src -= (43 - 19) * 2 * 43; //Restore src to the state before the inner loop
-        src += 2;
-    }
-
-    //Calculate Q parity
-    src = sector + HEADER_OFFSET;
-    dst = sector + CDROMXA_FORM1_PARITY_Q_OFFSET;
-    unsigned char* src_end = sector + CDROMXA_FORM1_PARITY_Q_OFFSET;
-    for(int i = 0; i < 26; ++i)
-    {
-        unsigned char* src_backup = src;
-        unsigned short x = 0x0000;
-        unsigned short y = 0x0000;
-        for(int j = 0; j < 43; ++j)
-        {
-            x ^= RSPCTable[j][src[0]]; //LSB
-            y ^= RSPCTable[j][src[1]]; //MSB
-            src += 2 * 44;
-            if(src >= src_end)
-            {
-                src = src - (HEADER_SIZE + CDROMXA_SUBHEADER_SIZE + CDROMXA_FORM1_USER_DATA_SIZE + EDC_SIZE + CDROMXA_FORM1_PARITY_P_SIZE);
-            }
-        }
+        printf("[i] Image converted to '%s'%s\n\n", output_path, job ? " (master disc sectors written)" : "");
+        ret = 0;
+    }
 
-        dst[         0] = x >> 8;
-        dst[2 * 26 + 0] = x & 0xFF;
-        dst[         1] = y >> 8;
-        dst[2 * 26 + 1] = y & 0xFF;
-        dst += 2;
-        src = src_backup;
-        src += 2 * 43;
+cleanup:
+    for (int i = 0; cv.slots && i < p.num_slots; i++) {
+        free(cv.slots[i].in);
+        free(cv.slots[i].out);
+    }
+    free(cv.slots);
+    free(boot);
+    free(cv.original);
+    image_close(&img);
+
+    // don't leave a partial image behind
+    if (created) {
+        image_close(&out);
+        if (ret < 0)
+            remove(output_path);
     }
 
-    //Restore header
-    sector[HEADER_OFFSET + 0] = minutes;
-    sector[HEADER_OFFSET + 1] = seconds;
-    sector[HEADER_OFFSET + 2] = blocks;
-    sector[HEADER_OFFSET + 3] = mode;
+    return ret;
+}
+
+typedef struct {
+    uint8_t *in;                // image sectors (encoder) or runs + records (decoder)
+    uint8_t *out;               // records (encoder) or image sectors (decoder)
+    uint8_t types[ECM_CHUNK_SECTORS];
+    uint8_t runs[ECM_RUNS_MAX];
+    ecm_chunk_t hdr;
+    bool bad;                   // unreadable or corrupt chunk
+} ecm_slot_t;
+
+typedef struct {
+    image_t *img;               // input (CD image or ECM file)
+    image_t *out;               // output (ECM file or CD image)
+    const ps2m_ctx_t *ctx;      // image geometry
+    bool decode;
+    uint32_t num_sectors;
+    uint64_t offset;            // decoder: offset of the next chunk in the ECM file
+    uint64_t out_offset;        // encoder: offset of the next chunk in the ECM file
+    uint8_t *boot;              // decoder: rebuilt boot area, held back to be patched (NULL = no patch)
+    ecm_slot_t *slots;
+    uint32_t records[PS2M_REDUCED_TYPES];
+    bool read_error, write_error;
+} ecm_t;
+
+// Reads the next chunk of the ECM file (header, runs and records)
+static bool ecm_read_chunk(ecm_t *e, uint32_t c, ecm_slot_t *slot)
+{
+    uint32_t count = e->num_sectors - c * ECM_CHUNK_SECTORS;
+
+    if (count > ECM_CHUNK_SECTORS)
+        count = ECM_CHUNK_SECTORS;
+
+    if (!image_read(e->img, e->offset, &slot->hdr, sizeof(ecm_chunk_t)) || slot->hdr.count != count ||
+        slot->hdr.runs_size > ECM_RUNS_MAX || slot->hdr.records_size > (size_t)count * e->ctx->sector_size)
+        return false;
 
-    fseek(inputfile, -SECTOR_SIZE, SEEK_CUR);
-    //Write fixed sector to output file
-    if(fwrite(sector, 1, SECTOR_SIZE, inputfile) != SECTOR_SIZE)
+    e->offset += sizeof(ecm_chunk_t);
+    if (!image_read(e->img, e->offset, slot->runs, slot->hdr.runs_size) ||
+        !image_read(e->img, e->offset + slot->hdr.runs_size, slot->in, slot->hdr.records_size))
         return false;
 
-    //Signal successful operation and return status
+    e->offset += slot->hdr.runs_size + slot->hdr.records_size;
     return true;
 }
 
-///////////////////////////////////////////////////////////
-// this calculates the 3 magic numbers mentioned above
-// 
-// args:    discNameLetters: 4 letters from the discname (eg SLES)
-//              (the letters must be between A and Z, capital letters only)
-//          discNameNumbers: the disc number (eg 12345)
-//              (the disc number must be between 0 and 99999)
-//          magic1: placeholder for magic number 1
-//          magic2: placeholder for magic number 2
-//          magic3: placeholder for magic number 3
-// returns: true  if ok
-//          false if error
-bool calcMagicNums(const char discNameLetters[4], int discNameNumbers, unsigned char *magic1, unsigned int *magic2, unsigned char *magic3)
+// Reader: reads consecutive chunks (image sectors, or ECM chunks)
+static void ecm_read(void *arg, int s, uint32_t c)
 {
-    unsigned int letters=0;
-    unsigned int numbers=0;
+    ecm_t *e = arg;
+    ecm_slot_t *slot = &e->slots[s];
+    uint32_t sector_size = e->ctx->sector_size;
+    uint32_t start = c * ECM_CHUNK_SECTORS;
+
+    memset(&slot->hdr, 0, sizeof(ecm_chunk_t));
+    slot->hdr.count = e->num_sectors - start;
+    if (slot->hdr.count > ECM_CHUNK_SECTORS)
+        slot->hdr.count = ECM_CHUNK_SECTORS;
+
+    // a bad ECM chunk loses the offset of all the next ones
+    if (e->decode)
+        slot->bad = (e->read_error || !ecm_read_chunk(e, c, slot));
+    else
+        slot->bad = !image_read(e->img, (uint64_t)start * sector_size, slot->in, (size_t)slot->hdr.count * sector_size);
 
-    // check discname letters to make sure they are valid
-    for(int i=0; i<4; i++)
-        if(discNameLetters[i] < 'A' || discNameLetters[i] > 'Z')
-            return false;
-    // check discname numbers to make sure they are valid
-    if(discNameNumbers < 0 || discNameNumbers > 99999)
-        return false;
-    
-    // make letters fit into a single u_int
-    letters =   (unsigned int)(discNameLetters[3]<< 0) | (unsigned int)(discNameLetters[2]<< 7) |
-                (unsigned int)(discNameLetters[1]<<14) | (unsigned int)(discNameLetters[0]<<21);
-    // number already fits into a u_int
-    numbers = discNameNumbers;
-
-    // calculate magic numbers
-    *magic1 = ((numbers &  0x1F) <<  3) | ((0x0FFFFFFF & letters) >> 25);
-    *magic2 = ( numbers          >> 10) | ((0x0FFFFFFF & letters) <<  7);
-    *magic3 = ((numbers & 0x3E0) >>  2) | 0x04;
-    
-    return true;
+    if (slot->bad)
+        e->read_error = true;
+}
+
+// Worker: reduces the sectors of a chunk to records, or rebuilds them and checks the hash
+static void ecm_work(void *arg, int s, uint32_t c)
+{
+    ecm_t *e = arg;
+    ecm_slot_t *slot = &e->slots[s];
+    size_t sector_size = e->ctx->sector_size;
+    uint32_t lba = c * ECM_CHUNK_SECTORS, count = slot->hdr.count;
+
+    if (slot->bad)
+        return;
+
+    if (e->decode)
+    {
+        slot->bad = (!ecm_unpack_types(slot->types, count, slot->runs, slot->hdr.runs_size) ||
+                     !ps2m_sectors_rebuild(e->ctx, slot->out, count, lba, slot->types, slot->in, slot->hdr.records_size) ||
+                     backup_hash(slot->out, count * sector_size) != slot->hdr.hash);
+    }
+    else
+    {
+        slot->hdr.records_size = ps2m_sectors_reduce(e->ctx, slot->in, count, lba, slot->types, slot->out);
+        slot->hdr.runs_size = ecm_pack_types(slot->runs, slot->types, count);
+        slot->hdr.hash = backup_hash(slot->in, count * sector_size);
+    }
+}
+
+// Writer: ECM chunks one after the other, or image sectors at their offset
+// (the rebuilt boot area is held back when it gets patched)
+static void ecm_write(void *arg, int s, uint32_t c)
+{
+    ecm_t *e = arg;
+    ecm_slot_t *slot = &e->slots[s];
+    size_t sector_size = e->ctx->sector_size;
+    size_t skip = 0;
+
+    if (slot->bad)
+    {
+        if (e->decode && !e->read_error)
+            printf("[!] Error! Chunk %u (LBA %u-%u) is corrupt.\n", c, c * ECM_CHUNK_SECTORS, c * ECM_CHUNK_SECTORS + slot->hdr.count - 1);
+        e->write_error = true;
+        return;
+    }
+
+    for (uint32_t i = 0; i < slot->hdr.count; i++)
+        e->records[slot->types[i]]++;
+
+    if (!e->decode)
+    {
+        if (!image_write(e->out, e->out_offset, &slot->hdr, sizeof(ecm_chunk_t)) ||
+            !image_write(e->out, e->out_offset + sizeof(ecm_chunk_t), slot->runs, slot->hdr.runs_size) ||
+            !image_write(e->out, e->out_offset + sizeof(ecm_chunk_t) + slot->hdr.runs_size, slot->out, slot->hdr.records_size))
+            e->write_error = true;
+
+        e->out_offset += sizeof(ecm_chunk_t) + slot->hdr.runs_size + slot->hdr.records_size;
+        return;
+    }
+
+    if (c == 0 && e->boot)
+    {
+        skip = PS2M_BOOT_SECTORS * sector_size;
+        memcpy(e->boot, slot->out, skip);
+    }
+
+    if (!image_write(e->out, (uint64_t)c * ECM_CHUNK_SECTORS * sector_size + skip, slot->out + skip, (size_t)slot->hdr.count * sector_size - skip))
+        e->write_error = true;
 }
 
 ///////////////////////////////////////////////////////////
-// encrypts the raw ps2 logo
+// writes the master disc sectors into the boot area held back by the decoder
+// (the geometry and Disc ID come from the rebuilt image, which is complete
+// except for its boot area)
 //
-// args:    logo: pointer to raw logo in memory (12*2048bytes)
-//          discNameLetters: 4 letters from the discname (eg SLES)
-//              (the letters must be between A and Z, capital letters only)
-//          discNameNumbers: the disc number (eg 12345)
-//              (the disc number must be between 0 and 99999)
+// args:    job: master disc sector settings
+//          out: rebuilt image
+//          boot: rebuilt boot area
+//          boot_size: boot area size in bytes (16 sectors)
 // returns: true  if ok
 //          false if error
-bool EncryptLogo(unsigned char *logo, char discNameLetters[4], int discNameNumbers)
+static bool ecm_patch_boot(const patch_job_t *job, image_t *out, uint8_t *boot, size_t boot_size)
 {
-    unsigned char magicNum=0, magic3=0;
-    unsigned int i;
-    
-    // calculate the magic number needed for XORing
-    if(!calcMagicNums(discNameLetters, discNameNumbers, &magicNum, &i, &magic3))
+    uint8_t head[PS2M_PROBE_SIZE];
+    size_t len = (out->size < sizeof(head)) ? out->size : sizeof(head);
+    ps2m_ctx_t ctx;
+    patch_result_t res;
+    uint8_t *original;
+    bool ret = false;
+
+    // the image head as it will be once the boot area is written
+    memcpy(head, boot, (len < boot_size) ? len : boot_size);
+    if (len > boot_size && !image_read(out, boot_size, head + boot_size, len - boot_size))
+        len = boot_size;
+
+    memset(&res, 0, sizeof(res));
+    ps2m_init(&ctx);
+    if (!ps2m_probe_format(&ctx, head, len, out->size) || ctx.sector_size * PS2M_BOOT_SECTORS != boot_size) {
+        printf("\n[!] Error! The rebuilt image doesn't seems to be a CD Image file.\n");
         return false;
-    
-    // individually encrypt each pixel in the logo
-    // (even the extra bytes at the end of the pal logo)
-    for(i=0; i<12*2048; i++)
-        logo[i] = ((logo[i]<<5)|(logo[i]>>3)) ^ magicNum;
+    }
 
-    return true;
+    original = malloc(boot_size);
+    if (!original) {
+        printf("[!] Out of memory\n");
+        return false;
+    }
+
+    memcpy(original, boot, boot_size);
+    if (find_disc_id(job, out, &ctx, boot, &res, stdout) &&
+        patch_boot_area(job, &ctx, boot, original, out->size, &res, stdout) == 0)
+        ret = true;
+
+    free(original);
+    return ret;
 }
 
 ///////////////////////////////////////////////////////////
-// decrypts the raw ps2 logo
-// 
-// args:    logo: pointer to raw logo in memory (12*2048bytes)
-//          discNameLetters: 4 letters from the discname (eg SLES)
-//              (the letters must be between A and Z, capital letters only)
-//          discNameNumbers: the disc number (eg 12345)
-//              (the disc number must be between 0 and 99999)
-// returns: true  if ok
-//          false if error
-bool DecryptLogo(unsigned char *logo, const char discNameLetters[4], int discNameNumbers)
+// stores a CD image without the fields that can be regenerated (ECM file),
+// or rebuilds the bit-exact CD image from an ECM file
+// (reader -> worker pool -> ordered writer, see ecm.h for the file layout)
+//
+// args:    path: input path (CD image, or ECM file if decode is set)
+//          output_path: output path (ECM file, or CD image)
+//          decode: rebuild the CD image from an ECM file
+//          job: decoder master disc sector settings (NULL = no patch), the
+//               rebuilt boot area is patched before it is written
+//          threads: worker threads (0 = number of CPUs)
+// returns: 0 if ok
+//          -1 if error
+int ecm_image(const char *path, const char *output_path, bool decode, const patch_job_t *job, int threads)
 {
-    unsigned char magicNum=0, magic3=0;
-    unsigned int i;
-    
-    // calculate the magic number needed for XORing
-    if(!calcMagicNums(discNameLetters, discNameNumbers, &magicNum, &i, &magic3))
-        return false;
-    
-    // individually decrypt each pixel in the logo
-    // (even the extra bytes at the end of the pal logo)
-    for(i=0; i<12*2048; i++)
-        logo[i] = ((logo[i]^magicNum)>>5)|((logo[i]^magicNum)<<3);
-    
-    return true;
+    ecm_t e;
+    ecm_header_t hdr;
+    image_t img, out;
+    ps2m_ctx_t ctx;
+    pipeline_t p;
+    struct stat in_st, out_st;
+    bool created = false;
+    double start, elapsed;
+    int ret = -1;
+
+    printf("[i] Reading '%s'...\n", path);
+    if (!image_open(&img, path, IMAGE_RDONLY)) {
+        perror("Failed to open file!");
+        return -1;
+    }
+
+    ps2m_init(&ctx);
+    memset(&hdr, 0, sizeof(hdr));
+    if (decode)
+    {
+        if (!image_read(&img, 0, &hdr, sizeof(hdr)) || !ecm_check_header(&hdr) ||
+            !ps2m_set_format(&ctx, PS2M_DISC_CD, hdr.sector_size, hdr.image_size / hdr.sector_size)) {
+            printf("\n[!] Error! File doesn't seems to be an ECM file.\n");
+            image_close(&img);
+            return -1;
+        }
+    }
+    else
+    {
+        if (!probe_image(&img, &ctx) || !ctx.edc_ecc) {
+            printf("\n[!] Error! File doesn't seems to be a CD Image file.\n");
+            image_close(&img);
+            return -1;
+        }
+
+        memcpy(hdr.magic, ECM_MAGIC, sizeof(hdr.magic));
+        hdr.sector_size = ctx.sector_size;
+        hdr.chunk_sectors = ECM_CHUNK_SECTORS;
+        hdr.image_size = img.size;
+        hdr.num_chunks = (ctx.num_sectors + ECM_CHUNK_SECTORS - 1) / ECM_CHUNK_SECTORS;
+    }
+
+    if (threads <= 0)
+        threads = get_cpu_count();
+
+    memset(&e, 0, sizeof(e));
+    e.img = &img;
+    e.out = &out;
+    e.ctx = &ctx;
+    e.decode = decode;
+    e.num_sectors = ctx.num_sectors;
+    e.offset = sizeof(hdr);
+    e.out_offset = sizeof(hdr);
+
+    memset(&p, 0, sizeof(p));
+    p.arg = &e;
+    p.num_chunks = hdr.num_chunks;
+    p.num_slots = threads * 2 + 2;
+    p.threads = threads;
+    p.read = ecm_read;
+    p.work = ecm_work;
+    p.write = ecm_write;
+
+    printf("    + %u %u-byte sectors (%" PRIu64 " bytes)\n", ctx.num_sectors, ctx.sector_size, hdr.image_size);
+
+    if (job && e.num_sectors < PS2M_BOOT_SECTORS) {
+        printf("\n[!] Error! Could not read the image boot sectors.\n");
+        goto cleanup;
+    }
+
+    // never truncate the input file
+    if (stat(output_path, &out_st) == 0 && stat(path, &in_st) == 0 &&
+        in_st.st_dev == out_st.st_dev && in_st.st_ino == out_st.st_ino) {
+        printf("\n[!] Error! The output file can't be the input file.\n\n");
+        goto cleanup;
+    }
+
+    if (!image_create(&out, output_path, decode ? hdr.image_size : 0)) {
+        printf("[!] Failed to create '%s'\n", output_path);
+        goto cleanup;
+    }
+    created = true;
+
+    e.slots = calloc(p.num_slots, sizeof(ecm_slot_t));
+    for (int i = 0; e.slots && i < p.num_slots; i++)
+        if (!(e.slots[i].in = malloc(ECM_CHUNK_SECTORS * ctx.sector_size)) ||
+            !(e.slots[i].out = malloc(ECM_CHUNK_SECTORS * ctx.sector_size)))
+            break;
+
+    if (job)
+        e.boot = malloc(PS2M_BOOT_SECTORS * ctx.sector_size);
+
+    if (!e.slots || !e.slots[p.num_slots - 1].out || (job && !e.boot)) {
+        printf("[!] Out of memory\n");
+        goto cleanup;
+    }
+
+    printf("[i] %s '%s' using %d threads...\n", decode ? "Rebuilding" : "Writing", output_path, threads);
+    start = get_time();
+
+    if (!decode)
+        e.write_error = !image_write(&out, 0, &hdr, sizeof(hdr));
+
+    if (!pipeline_run(&p)) {
+        printf("[!] Error! Could not start the worker threads.\n\n");
+        goto cleanup;
+    }
+
+    elapsed = get_time() - start;
+
+    printf("[i] %u Mode 1, %u Form 1, %u Form 2 (%u without EDC) and %u Mode 0 sectors, %u stored as is\n",
+        e.records[PS2M_REDUCED_MODE1], e.records[PS2M_REDUCED_FORM1],
+        e.records[PS2M_REDUCED_FORM2] + e.records[PS2M_REDUCED_FORM2_NOEDC], e.records[PS2M_REDUCED_FORM2_NOEDC],
+        e.records[PS2M_REDUCED_MODE0], e.records[PS2M_REDUCED_RAW]);
+    if (!decode)
+        printf("    + %" PRIu64 " -> %" PRIu64 " bytes (%.1f%%)\n", hdr.image_size, e.out_offset,
+            hdr.image_size ? e.out_offset * 100.0 / hdr.image_size : 0.0);
+    printf("    + %.2f s, %.1f MB/s (%.0f sectors/s)\n\n", elapsed,
+        elapsed > 0 ? hdr.image_size / elapsed / (1024 * 1024) : 0.0,
+        elapsed > 0 ? e.num_sectors / elapsed : 0.0);
+
+    if (e.read_error || e.write_error) {
+        printf("[!] Error! Could not %s some sectors.\n\n", e.read_error ? "read" : (decode ? "rebuild" : "write"));
+        goto cleanup;
+    }
+
+    // patch-on-decode: the held back boot area is patched, then written once
+    if (job)
+    {
+        if (!ecm_patch_boot(job, &out, e.boot, PS2M_BOOT_SECTORS * ctx.sector_size))
+            goto cleanup;
+
+        if (!image_write(&out, 0, e.boot, PS2M_BOOT_SECTORS * ctx.sector_size)) {
+            printf("\n[!] Error writing master disc sectors!\n\n");
+            goto cleanup;
+        }
+        printf("    + Master disc sectors written to '%s'\n\n", output_path);
+    }
+
+    ret = 0;
+
+cleanup:
+    for (int i = 0; e.slots && i < p.num_slots; i++) {
+        free(e.slots[i].in);
+        free(e.slots[i].out);
+    }
+    free(e.slots);
+    free(e.boot);
+    image_close(&img);
+
+    // don't leave a partial file behind
+    if (created) {
+        image_close(&out);
+        if (ret < 0)
+            remove(output_path);
+    }
+
+    return ret;
 }
 
-int write_master_disc_sector(FILE *file, 
-                            const char *disc_name, int disc_id,
-                            const char *producer_name,
-                            const char *copyright_holder,
-                            int year, int month, int day,
-                            uint8_t region,
-                            uint8_t disc_type,
-                            uint32_t num_image_sectors,
-                            const char *cdvdgen_version)
-{
-    char tmp_formatted[16];
-    MasterDiscSector sector;
-    
-    if (!file) {
-        perror("Failed to open file");
+///////////////////////////////////////////////////////////
+// restores the original boot area of a patched image from the backup store
+//
+// args:    path: patched image path
+//          store: backup store directory
+// returns: 0 if ok
+//          -1 if error
+int restore_image(const char *path, const char *store)
+{
+    image_t img;
+    ps2m_ctx_t ctx;
+    uint8_t *boot, *original;
+    size_t boot_size;
+    char disc_id[16];
+    int ret = -1;
+
+    printf("[i] Reading '%s'...\n", path);
+    if (!image_open(&img, path, IMAGE_RDWR)) {
+        perror("Failed to open file!");
+        return -1;
+    }
+
+    ps2m_init(&ctx);
+    if (!probe_image(&img, &ctx)) {
+        printf("\n[!] Error! File doesn't seems to be a CD or DVD Image file.\n\n");
+        image_close(&img);
         return -1;
     }
-    
-    memset(&sector, 0, sizeof(sector));
 
-    // Magic numbers
-    if (!calcMagicNums(disc_name, disc_id,  &sector.magic1_first, &sector.magic2_first, &sector.magic3))
-    {
-        fprintf(stderr, "Error calculating magic numbers\n");
-        fclose(file);
+    boot_size = PS2M_BOOT_SECTORS * ctx.sector_size;
+    boot = image_read_boot(&img, boot_size);
+    original = boot ? malloc(boot_size) : NULL;
+    if (!original) {
+        printf("\n[!] Error! Could not read the image boot sectors.\n\n");
+        image_close(&img);
         return -1;
     }
-    sector.magic1_second = sector.magic1_first;
-    sector.magic2_second = sector.magic2_first;
-    
-    // Fill basic information
-    snprintf(tmp_formatted, sizeof(tmp_formatted), "%s-%05d", disc_name, disc_id);
-    pad_string(sector.disc_name, tmp_formatted, sizeof(sector.disc_name));
-    pad_string(sector.producer_name, producer_name, sizeof(sector.producer_name));
-    pad_string(sector.copyright_holder, copyright_holder, sizeof(sector.copyright_holder));
-    
-    sector.year_bcd = int_to_bcd(year % 100) << 16 | int_to_bcd(year / 100);
-    sector.month_bcd = int_to_bcd(month);
-    sector.day_bcd = int_to_bcd(day);
-    
-    memcpy(sector.master_disc_text, "PlayStation Master Disc ", sizeof(sector.master_disc_text));
-    sector.playstation_version = 0x32;
-    sector.region = region;
-    sector.reserved1 = 0x00;
-    sector.disc_type = disc_type;
-    
-    // Handle media-specific section
-    if (disc_type == DISC_CD)
-    { // CD
-        memset(sector.media_specific.cd.cd_filler, ' ', sizeof(sector.media_specific.cd.cd_filler));
-    } else if (disc_type == DISC_DVD)
-    { // DVD
-        sector.media_specific.dvd.dvd_byte1 = 0x01;
-        sector.media_specific.dvd.dvd_byte2 = 0x00;
-        sector.media_specific.dvd.sector_count_adjusted = ((((num_image_sectors + 15) / 16) * 16) - 1);
-        sector.media_specific.dvd.dvd_reserved = 0x00000000;
-        memset(sector.media_specific.dvd.dvd_filler, ' ', sizeof(sector.media_specific.dvd.dvd_filler));
-    }
-    
-    // Common section
-    sector.common_byte1 = 0x01;
-    sector.common_ff = 0xFFFFFFFFFFFFFFFF;
-    
-    sector.reserved2 = 0x0000;
-    sector.section1_byte1 = 0x01;
-    sector.section1_value1 = 0x0000004B;
-    sector.section1_value2 = 0x0000104A;
-        
-    sector.reserved3 = 0x0000;
-    sector.section2_byte1 = 0x03;
-    sector.section2_value1 = 0x0000004B;
-    sector.section2_value2 = 0x0000104A;
-    
-    sector.zeros1 = 0x00000000;
-    sector.reserved4 = 0x0000;
-    sector.zeros2 = 0x00000000;
-    sector.zeros3 = 0x00000000;
-    sector.zeros4 = 0x00000000;
-    sector.zeros5 = 0x00000000;
-    
-    memset(sector.zeros_large, 0x00, sizeof(sector.zeros_large));
-    memset(sector.spaces1, ' ', sizeof(sector.spaces1));
-    
-    // Format CDVDGEN text
-    snprintf(tmp_formatted, sizeof(tmp_formatted), "CDVDGEN %s", cdvdgen_version);
-    pad_string(sector.cdvdgen_text, tmp_formatted, sizeof(sector.cdvdgen_text));
-    
-    memset(sector.spaces2, ' ', sizeof(sector.spaces2));
-
-    if (region == 1) // Japan region
-    {
-        JapanMasterDiscSector *header = (JapanMasterDiscSector *)&sector;
-
-        header->magic3 = sector.magic3;
-        header->magic2_second = sector.magic2_first;
-        header->magic1_second = sector.magic1_first;
-
-        header->reserved1 = 0x30;
-        header->field_270 = 0x0000;
-        header->field_272 = 0x02;
-        header->common_ff2 = 0xFFFFFFFFFFFFFFFF;
-        header->field_281 = 0x00000000;
-        header->field_285 = 0x80;
-        header->field_286 = 0x0000;
-        header->field_288 = 0x01;
-        header->field_289 = 0x0000004B;
-        header->field_293 = 0x0000104A;
-        header->field_302 = 0x0000;
-        header->field_304 = 0x03;
-        header->field_305 = 0x0000004B;
-        header->field_309 = 0x0000104A;
-        header->field_313 = 0x00000000;
-        header->field_318 = 0x00;
-        header->field_319 = 0x80;
-    }
-
-    // Write the sector twice as specified
-    for (int i = 0; i < 2; i++)
-    {
-        if (disc_type == DISC_CD) // CD-XA Mode 2
-            fseek(file, 0x18, SEEK_CUR);
-
-        if (fwrite(&sector, sizeof(sector), 1, file) != 1) {
-            perror("Failed to write sector");
-            fclose(file);
-            return -1;
+
+    if (!ps2m_master_disc_id(&ctx, boot, disc_id))
+        printf("[!] Error! Image doesn't have a master disc sector.\n\n");
+    else if (!backup_load(store, disc_id, img.size, boot, original, boot_size))
+        printf("[!] Error! No backup found for %s in '%s'\n\n", disc_id, store);
+    else
+    {
+        // one positional write of the whole original boot area
+        memcpy(boot, original, boot_size);
+        if (image_commit_boot(&img)) {
+            printf("    + Original boot area of %s restored\n\n", disc_id);
+            ret = 0;
         }
+        else
+            printf("[!] Error writing boot area!\n\n");
+    }
+
+    free(original);
+    image_close(&img);
+
+    return ret;
+}
+
+///////////////////////////////////////////////////////////
+// prints the master disc sector fields and checks of an image
+// (only the boot area is read, the image is opened read-only)
+//
+// args:    path: image path
+// returns: 0 if the image has a valid master disc sector and logo
+//          1 if the image is not patched
+//          -1 if error or invalid
+int inspect_image(const char *path)
+{
+    image_t img;
+    ps2m_ctx_t ctx;
+    ps2m_master_status_t master;
+    const uint8_t *boot;
+    static const char *logo_names[] = { "invalid", "empty", "NTSC", "PAL" };
+
+    printf("[i] Reading '%s'...\n", path);
+    if (!image_open(&img, path, IMAGE_RDONLY)) {
+        perror("Failed to open file!");
+        return -1;
+    }
 
-        // Update CD sector EDC/ECC data
-        if (disc_type == DISC_CD)
-            fixMode2Form1Sector(file, 14 + i);
+    ps2m_init(&ctx);
+    if (!probe_image(&img, &ctx)) {
+        printf("\n[!] Error! File doesn't seems to be a CD or DVD Image file.\n\n");
+        image_close(&img);
+        return -1;
     }
-    
-    return 0;
+    printf("    + Detected %s Image (%u-byte sectors)\n", (ctx.disc_type == PS2M_DISC_DVD) ? "DVD-ROM" : "CD-ROM", ctx.sector_size);
+
+    boot = image_read_boot(&img, PS2M_BOOT_SECTORS * ctx.sector_size);
+    if (!boot) {
+        printf("\n[!] Error! Could not read the image boot sectors.\n\n");
+        image_close(&img);
+        return -1;
+    }
+
+    if (ps2m_inspect(&ctx, boot, &master) == PS2M_MASTER_NONE)
+    {
+        uint8_t magic1 = 0;
+        int logo = ps2m_logo_recover_magic(&ctx, boot, &magic1);
+
+        printf("[i] No master disc sector found (image not patched), PS2 logo: %s", logo_names[logo]);
+        if (logo == PS2M_LOGO_NTSC || logo == PS2M_LOGO_PAL)
+            printf(" (magic1 %02X)", magic1);
+        printf("\n\n");
+        image_close(&img);
+        return 1;
+    }
+
+    printf("[i] Master disc sector:\n");
+    printf("    + Disc ID       : %s\n", master.disc_id);
+    printf("    + Producer      : %s\n", master.producer_name);
+    printf("    + Copyright     : %s\n", master.copyright_holder);
+    printf("    + Date          : %04d-%02d-%02d\n", master.year, master.month, master.day);
+    printf("    + Region        : %s\n", region_name(master.region));
+    printf("    + Disc type     : %s\n", master.disc_type == PS2M_DISC_CD ? "CD" : (master.disc_type == PS2M_DISC_DVD ? "DVD" : "-"));
+    printf("    + CDVDGEN       : %s\n", master.cdvdgen_version);
+    printf("    + Magic numbers : %02X %08X %02X (%s)\n", master.magic1, master.magic2, master.magic3, master.magic_ok ? "OK" : "BAD");
+    printf("    + Sectors       : %s\n", master.sectors_ok ? "OK" : (ctx.disc_type == PS2M_DISC_CD ? "BAD (copies, EDC/ECC)" : "BAD (copies, sector count)"));
+    printf("    + PS2 logo      : %s\n", logo_names[master.logo]);
+
+    image_close(&img);
+
+    if (master.status == PS2M_MASTER_OK && master.logo != PS2M_LOGO_INVALID && master.logo != PS2M_LOGO_EMPTY) {
+        printf("[i] Image is patched OK\n\n");
+        return 0;
+    }
+
+    printf("[!] Image has an invalid master disc sector or logo\n\n");
+    return -1;
 }
 
 void usage(const char* app_bin)
 {
     puts("This program accepts PS2 DVD (.ISO) and PS2 CD (.BIN) images\n");
-    printf("Usage :\n%s <input.ISO/input.BIN> [region]\n\n", app_bin);
+    printf("Usage :\n%s <input.ISO/input.BIN> [region] [-o output]\n", app_bin);
+    printf("%s batch [-j threads] [-r region] [-o outdir] [-s summary.txt] [-m manifest.txt] [input1 input2 ...]\n", app_bin);
+    printf("%s verify [-j threads] <input.BIN>\n", app_bin);
+    printf("%s repair [-j threads] <input.BIN>\n", app_bin);
+    printf("%s convert [-j threads] [-p] [-r region] <input.ISO/input.BIN> <output.BIN/output.ISO>\n", app_bin);
+    printf("%s ecm [-j threads] <input.BIN> <output.ECM>\n", app_bin);
+    printf("%s unecm [-j threads] [-p] [-r region] <input.ECM> <output.BIN>\n", app_bin);
+    printf("%s restore <input1> [input2 ...]\n", app_bin);
+    printf("%s inspect <input1> [input2 ...]\n\n", app_bin);
     puts("Information :");
-    puts(" - region   : J/U/E/W (Japan/USA/Europe/World - optional, default=USA)\n");
+    puts(" - region   : J/U/E/W (Japan/USA/Europe/World - optional, default=USA)");
+    puts(" - output   : write the patched image to a new file, the input is left untouched");
+    puts("              (copy-on-write reflink when the filesystem supports it)");
+    puts(" - outdir   : write the patched images to this directory");
+    puts(" - threads  : number of worker threads (default=number of CPUs)");
+    puts(" - summary  : per-image result summary file (default=stdout)");
+    puts(" - manifest : one image per line, with optional comma separated fields:");
+    puts("              path,region,producer name,copyright holder,YYYY-MM-DD,CDVDGEN version");
+    puts(" - convert  : ISO (2048-byte sectors) to BIN (2352-byte Mode 2 Form 1 sectors) or BIN to ISO,");
+    puts("              -p (or -r) also writes the master disc sectors of the new image");
+    puts(" - ecm      : store a CD image without the sync/header/EDC/ECC data that can be regenerated,");
+    puts("              unecm rebuilds the original image (-p/-r: already master-patched)");
+    puts(" - restore  : put back the original boot area of patched images");
+    puts("              (backups are kept in $" BACKUP_ENV " or ~/" BACKUP_DEFAULT_DIR ")\n");
     return;
 }
 
-off_t get_file_size(FILE *file)
+int main_batch(int argc, char *argv[])
 {
-    fseek(file, 0, SEEK_END);
-    off_t size = ftell(file);
-    fseek(file, 0, SEEK_SET);
-    return size;
-}
-
-int main(int argc, char *argv[])
-{
-    uint8_t buffer[12*2048];
-    uint8_t backup[2*0x930];
-    char tmp[0x40];
-    char prod_code[5];
-    int pal, prod_num = -1;
-    off_t file_size;
-    FILE *fp, *fout;
-    uint32_t sector_size = 0;
-    uint8_t disc_type = DISC_NONE;
-    uint8_t region = REGION_USA;
- 
-    printf("\n\tPlayStation 2 Master Disc Boot Patcher by Bucanero\n\n");
+    patch_job_t *jobs = NULL;
+    int count = 0, threads = 0, ret = -1;
+    const char *summary_file = NULL;
+    const char *output_dir = NULL;
+    uint8_t region = PS2M_REGION_USA;
+    char path[1024];
+
+    for (int i = 2; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+            threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+            summary_file = argv[++i];
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            output_dir = argv[++i];
+        else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+        {
+            if (!parse_region(argv[++i], &region)) {
+                usage(argv[0]);
+                printf("[!] Unknown region code '%s'\n\n", argv[i]);
+                goto cleanup;
+            }
+        }
+        else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc)
+        {
+            if (!load_manifest(argv[++i], &jobs, &count, region))
+                goto cleanup;
+        }
+        else if (!add_job(&jobs, &count, argv[i], region))
+            goto cleanup;
+    }
 
-    if (argc < 2) {
+    if (!count) {
         usage(argv[0]);
-        return -1;
+        goto cleanup;
     }
 
-    if (argc == 3)
+    for (int i = 0; output_dir && i < count; i++)
     {
-        switch (argv[2][0]) {
-            case 'J':
-            case 'j':
-                printf("[i] Forcing Japan region\n");
-                region = REGION_JAPAN;
-                break;
-            case 'U':
-            case 'u':
-                printf("[i] Forcing USA region\n");
-                region = REGION_USA;
-                break;
-            case 'E':
-            case 'e':
-                printf("[i] Forcing Europe region\n");
-                region = REGION_EUROPE;
-                break;
-            case 'W':
-            case 'w':
-                printf("[i] Forcing World region\n");
-                region = REGION_WORLD;
-                break;
-            default:
-                usage(argv[0]);
-                printf("[!] Unknown region code '%s'\n\n", argv[2]);
-                return -1;
+        const char *name = strrchr(jobs[i].path, '/');
+
+        if (snprintf(path, sizeof(path), "%s/%s", output_dir, name ? name + 1 : jobs[i].path) >= (int)sizeof(path)) {
+            printf("[!] Output path too long for '%s'\n", jobs[i].path);
+            goto cleanup;
+        }
+
+        // images with the same file name would overwrite each other's copy
+        for (int j = 0; j < i; j++)
+            if (strcmp(jobs[j].output_path, path) == 0) {
+                printf("[!] '%s' and '%s' would both be written to '%s'\n", jobs[j].path, jobs[i].path, path);
+                goto cleanup;
+            }
+
+        if (!(jobs[i].output_path = strdup(path))) {
+            printf("[!] Out of memory\n");
+            goto cleanup;
         }
     }
 
-    printf("[i] Reading '%s'...\n", argv[1]);
-    fp = fopen(argv[1], "r+b");
-    if (!fp) {
-        perror("Failed to open file!");
+    ret = (run_batch(jobs, count, threads, summary_file) ? -1 : 0);
+
+cleanup:
+    free_jobs(jobs, count);
+    return ret;
+}
+
+int main_inspect(int argc, char *argv[])
+{
+    int ret = 0;
+
+    if (argc < 3) {
+        usage(argv[0]);
         return -1;
     }
 
-    file_size = get_file_size(fp);
-    printf("    + Image size: %" PRId64 " bytes\n", (int64_t)file_size);
+    for (int i = 2; i < argc; i++)
+    {
+        int r = inspect_image(argv[i]);
 
-    if (file_size % 0x800 == 0) {
-        printf("    + Detected DVD-ROM Image\n");
-        disc_type = DISC_DVD;
-        sector_size = 0x800;
-    }
-    else if (file_size % 0x930 == 0) {
-        printf("    + Detected CD-ROM Image\n");
-        disc_type = DISC_CD;
-        sector_size = 0x930;
-        fseek(fp, 0x18, SEEK_SET); // CD-XA Mode 2 Form 1 offset
+        // report the worst result
+        if (r < 0 || (r > 0 && ret == 0))
+            ret = r;
     }
-    else {
-        printf("\n[!] Error! File doesn't seems to be a CD or DVD Image file.\n");
-        fclose(fp);
+
+    return ret;
+}
+
+int main_restore(int argc, char *argv[])
+{
+    char store[BACKUP_PATH_MAX];
+    int failed = 0;
+
+    if (argc < 3) {
+        usage(argv[0]);
         return -1;
     }
 
-    // Read first 12 sectors (PS2 logo)
-    for (int i = 0; i < 12; i++)
-    {
-        fread(buffer + i * 0x800, 0x800, 1, fp);
-        if (disc_type == DISC_CD)
-            fseek(fp, 0x130, SEEK_CUR); // Skip CD sector extra data
+    if (!backup_store_dir(store, sizeof(store))) {
+        printf("[!] Error! Backup store path is too long (%s)\n", BACKUP_ENV);
+        return -1;
     }
+    for (int i = 2; i < argc; i++)
+        if (restore_image(argv[i], store) < 0)
+            failed++;
 
-    // Backup Master disc sectors (2 sectors: 14 & 15)
-    fseek(fp, sector_size * 14, SEEK_SET);
-    fread(backup, sector_size, 2, fp);
+    return (failed ? -1 : 0);
+}
 
-    if (disc_type == DISC_CD)
-        fseek(fp, 0x18, SEEK_CUR);
+// verify/repair command line: [-j threads] <input.BIN>
+int main_sectors(int argc, char *argv[])
+{
+    const char *path = NULL;
+    int threads = 0;
 
-    printf("[i] Searching for Disc ID in the image...\n");
-    while (fread(tmp, 1, sizeof(tmp), fp) == sizeof(tmp))
+    for (int i = 2; i < argc; i++)
     {
-        tmp[sizeof(tmp)-1] = 0;
-        if (wildcard_match(tmp, "BOOT2*cdrom0:\\*_*.*"))
-        {
-            printf("    + Found SYSTEM.CNF data at offset 0x%lX\n", ftell(fp) - sizeof(tmp));
-            strncpy(prod_code, strchr(tmp, '\\') + 1, 4);
-            prod_code[4] = 0;
-            sscanf(strchr(tmp, '\\') + 5, "_%d.%d", &pal, &prod_num);
-            prod_num += pal * 100;
-            pal = wildcard_match(tmp, "*VMODE*PAL*");
-            printf("    + Detected Disc ID: %s-%d (%s)\n", prod_code, prod_num, pal ? "PAL" : "NTSC");
-            break;
-        }
-        fseek(fp, sector_size-(sizeof(tmp)), SEEK_CUR);
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+            threads = atoi(argv[++i]);
+        else
+            path = argv[i];
     }
 
-    if (prod_num < 0) {
-        fclose(fp);
-        printf("\n[!] Error! Could not detect Disc ID in the image.\n");
+    if (!path) {
+        usage(argv[0]);
         return -1;
     }
 
-    // Check if boot sector is empty
-    if (crc32b(buffer, sizeof(buffer)) == 0x6EBED2EE)
-    {
-        printf("[!] Disc image has an empty boot sector.\n");
-        printf("    + Adding Encrypted PS2 logo (%s) to boot sector...\n", pal ? "PAL" : "NTSC");
+    if (strcmp(argv[1], "repair") == 0)
+        return repair_image(path, threads);
 
-        if (pal)
-            unlzari(lz_pal_bin, sizeof(lz_pal_bin), buffer, sizeof(buffer));
-        else
-            unlzari(lz_ntsc_bin, sizeof(lz_ntsc_bin), buffer, sizeof(buffer));
+    return verify_image(path, threads);
+}
 
-        EncryptLogo(buffer, prod_code, prod_num);
+// convert/ecm/unecm command line: [-j threads] [-p] [-r region] <input> <output>
+int main_convert(int argc, char *argv[])
+{
+    const char *path = NULL, *output = NULL;
+    uint8_t region = PS2M_REGION_USA;
+    bool patch = false;
+    patch_job_t job;
+    int threads = 0;
 
-        fseek(fp, (disc_type == DISC_CD) ? 0x18 : 0, SEEK_SET);
-        for (int i = 0; i < 12; i++)
+    for (int i = 2; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+            threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-p") == 0)
+            patch = true;
+        else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
         {
-            fwrite(buffer + i * 0x800, 0x800, 1, fp);
-            if (disc_type == DISC_CD)
-            {
-                fixMode2Form1Sector(fp, i);
-                fseek(fp, 0x18, SEEK_CUR);
+            if (!parse_region(argv[++i], &region)) {
+                usage(argv[0]);
+                printf("[!] Unknown region code '%s'\n\n", argv[i]);
+                return -1;
             }
+            patch = true;
         }
+        else if (!path)
+            path = argv[i];
+        else
+            output = argv[i];
     }
 
-    DecryptLogo(buffer, prod_code, prod_num);
-
-    switch (crc32b(buffer, sizeof(buffer)))
-    {
-    case 0x9F1AEE24:    // NTSC
-    case 0x87B50222:    // PAL
-        printf("[i] Encrypted PS2 logo matches %s-%d\n", prod_code, prod_num);
-        break;
-    
-    default:
-        printf("[!] Warning! Disc doesn't seems to have a valid PS2 logo at the start.\n");
-        break;
+    if (!path || !output || (patch && strcmp(argv[1], "ecm") == 0)) {
+        usage(argv[0]);
+        return -1;
     }
 
-    printf("[i] Backing up disc sectors...\n");
-    fout = fopen(disc_type == DISC_DVD ? "DVD_SECTORS.BIN" : "CD_SECTORS.BIN", "wb");
-    if (!fout) {
-        perror("Failed to open file");
+    set_job_defaults(&job, path, region);
+    job.scan_threads = threads;
+
+    if (strcmp(argv[1], "convert") == 0)
+        return convert_image(path, output, patch ? &job : NULL, threads);
+
+    return ecm_image(path, output, strcmp(argv[1], "unecm") == 0, patch ? &job : NULL, threads);
+}
+
+int main(int argc, char *argv[])
+{
+    patch_job_t job;
+    patch_result_t res;
+    uint8_t region = PS2M_REGION_USA;
+    const char *output = NULL;
+
+    printf("\n\tPlayStation 2 Master Disc Boot Patcher by Bucanero\n\n");
+
+    if (argc < 2) {
+        usage(argv[0]);
         return -1;
     }
 
-    fwrite(backup, sector_size, 2, fout);
-    fclose(fout);
-    printf("    + %s_SECTORS.BIN saved OK!\n", disc_type == DISC_DVD ? "DVD" : "CD");
-
-    printf("[i] Writing master disc sectors...\n");
-    fseek(fp, sector_size * 14, SEEK_SET);
-    // Create a PS2 DVD master disc sector
-    int result = write_master_disc_sector(
-        fp,                        // file pointer
-        prod_code, prod_num,       // disc name
-        "PS2 PATCHER",             // producer name
-        "SCE",                     // copyright holder
-        2009, 10, 3,               // year, month, day (BCD)
-        region,                    // region (USA)
-        disc_type,                 // disc type (CD or DVD)
-        (file_size / sector_size), // number of image sectors
-        "2.00"                     // CDVDGEN version
-    );
-
-    if(result < 0)
-        printf("\n[!] Error writing master disc sectors!\n\n");
-    else
-        printf("    + Master disc sectors written to '%s'\n\n", argv[1]);
+    if (strcmp(argv[1], "batch") == 0)
+        return main_batch(argc, argv);
 
-    fseek(fp, 0, SEEK_END);
-    fclose(fp);
+    if (strcmp(argv[1], "verify") == 0 || strcmp(argv[1], "repair") == 0)
+        return main_sectors(argc, argv);
 
-    return result;
+    if (strcmp(argv[1], "restore") == 0)
+        return main_restore(argc, argv);
+
+    if (strcmp(argv[1], "convert") == 0 || strcmp(argv[1], "ecm") == 0 || strcmp(argv[1], "unecm") == 0)
+        return main_convert(argc, argv);
+
+    if (strcmp(argv[1], "inspect") == 0)
+        return main_inspect(argc, argv);
+
+    for (int i = 2; i < argc; i++)
+    {
+        if ((strcmp(argv[i], "-o") == 0 || strcmp(argv[i], "--output") == 0) && i + 1 < argc)
+            output = argv[++i];
+        else if (!parse_region(argv[i], &region)) {
+            usage(argv[0]);
+            printf("[!] Unknown region code '%s'\n\n", argv[i]);
+            return -1;
+        }
+        else
+            printf("[i] Forcing %s region\n", region_name(region));
+    }
+
+    set_job_defaults(&job, argv[1], region);
+    job.output_path = output;
+
+    return patch_image(&job, &res, stdout);
 }
@@ -0,0 +1,122 @@
+/*
+ * SYSTEM.CNF parser microbenchmark
+ * --------------------------------
+ *
+ * Times the Disc ID detection hot path (make bench):
+ *   parse: ps2m_system_cnf_tokenize on every valid corpus file (tests/cnf)
+ *   scan:  ps2m_scan_system_cnf over 2352-byte sectors with BOOT2 decoys,
+ *          SYSTEM.CNF data in the last sector (Disc ID fallback search)
+ *
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "libps2master.h"
+
+#define CNF_CORPUS_DIR      "tests/cnf/"
+#define BENCH_TIME          0.2         // seconds per measure
+#define BENCH_SECTORS       4096
+
+static const char *bench_files[] = {
+    "sles_50123_pal.cnf",
+    "slus_20946_hdd.cnf",
+    "scps_15023_subdir.cnf",
+    "sles_52889_reordered.cnf",
+    "slpm_65432_padded.cnf",
+};
+
+static double get_time(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void bench_parse(const char *name)
+{
+    static char data[4096];
+    ps2m_system_cnf_t cnf;
+    char path[256];
+    double start, elapsed;
+    uint64_t runs = 0;
+    size_t len;
+    FILE *fp;
+
+    snprintf(path, sizeof(path), CNF_CORPUS_DIR "%s", name);
+    if (!(fp = fopen(path, "rb"))) {
+        printf("[!] Failed to open '%s'\n", path);
+        return;
+    }
+    len = fread(data, 1, sizeof(data), fp);
+    fclose(fp);
+
+    start = get_time();
+    do {
+        for (int i = 0; i < 10000; i++)
+            ps2m_system_cnf_tokenize(data, len, &cnf);
+        runs += 10000;
+        elapsed = get_time() - start;
+    } while (elapsed < BENCH_TIME);
+
+    printf("    + parse %-26s %5zu bytes  %6.1f ns/parse  %7.1f MB/s\n", name, len,
+        elapsed * 1e9 / runs, runs * len / elapsed / (1024 * 1024));
+}
+
+static void bench_scan(void)
+{
+    static const char cnf_data[] = "BOOT2 = cdrom0:\\SLES_501.23;1\r\nVER = 1.00\r\nVMODE = PAL\r\n";
+    size_t size = (size_t)BENCH_SECTORS * PS2M_CD_SECTOR_SIZE;
+    uint8_t *sectors = malloc(size);
+    ps2m_ctx_t ctx;
+    double start, elapsed = 0;
+    uint64_t runs = 0;
+
+    if (!sectors) {
+        printf("[!] Out of memory\n");
+        return;
+    }
+
+    // text-like data with a BOOT2 decoy (no valid line) in every sector
+    srand(19);
+    for (size_t i = 0; i < size; i++)
+        sectors[i] = ' ' + rand() % 95;
+    ps2m_init(&ctx);
+    ps2m_set_format(&ctx, PS2M_DISC_CD, PS2M_CD_SECTOR_SIZE, BENCH_SECTORS);
+    for (size_t i = 0; i < BENCH_SECTORS; i++)
+        memcpy(sectors + i * PS2M_CD_SECTOR_SIZE + ctx.data_offset + 1000, "BOOT2 = host:\\", 14);
+    memcpy(sectors + (BENCH_SECTORS - 1) * PS2M_CD_SECTOR_SIZE + ctx.data_offset, cnf_data, sizeof(cnf_data));
+
+    start = get_time();
+    do {
+        size_t pos = 0;
+
+        if (!ps2m_scan_system_cnf(&ctx, sectors, BENCH_SECTORS, &pos)) {
+            printf("[!] SYSTEM.CNF data not found\n");
+            break;
+        }
+        runs++;
+        elapsed = get_time() - start;
+    } while (elapsed < BENCH_TIME);
+
+    printf("    + scan  %u sectors with decoys        %6.1f us/scan   %7.1f MB/s\n", BENCH_SECTORS,
+        elapsed * 1e6 / runs, runs * size / elapsed / (1024 * 1024));
+
+    free(sectors);
+}
+
+int main(void)
+{
+    printf("[i] SYSTEM.CNF parser benchmark\n");
+
+    for (size_t i = 0; i < sizeof(bench_files) / sizeof(bench_files[0]); i++)
+        bench_parse(bench_files[i]);
+
+    bench_scan();
+
+    return 0;
+}
@@ -0,0 +1,50 @@
+/*
+ * SYSTEM.CNF parser invariants
+ * ----------------------------
+ *
+ * Shared by the corpus test (cnf_test.c) and the fuzz harness (cnf_fuzz.c):
+ * whatever the input, the parser must not read outside the data, every value
+ * must be a terminated string, and a Disc ID is only returned for a well
+ * formed cdrom0: XXXX_NNN.NN boot file.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "libps2master.h"
+
+// Checks a value field is terminated inside its buffer
+#define CNF_TERMINATED(field)   (memchr(field, 0, sizeof(field)) != NULL)
+
+///////////////////////////////////////////////////////////
+// parses SYSTEM.CNF data and checks the result
+//
+// args:    data: SYSTEM.CNF data (not terminated)
+//          size: data size
+//          cnf: placeholder for the parsed values
+// returns: the ps2m_system_cnf_tokenize result, or -1 if an invariant is broken
+static inline int cnf_check(const char *data, size_t size, ps2m_system_cnf_t *cnf)
+{
+    bool ok = ps2m_system_cnf_tokenize(data, size, cnf);
+
+    if (!CNF_TERMINATED(cnf->boot2) || !CNF_TERMINATED(cnf->version) ||
+        !CNF_TERMINATED(cnf->vmode) || !CNF_TERMINATED(cnf->hdd_unit_power) || !CNF_TERMINATED(cnf->prod_code))
+        return -1;
+
+    if (cnf->pal != (strncmp(cnf->vmode, "PAL", 3) == 0))
+        return -1;
+
+    if (!ok)
+        return (cnf->prod_num == -1) ? 0 : -1;
+
+    if (strncmp(cnf->boot2, "cdrom0:", 7) != 0 || strlen(cnf->prod_code) != 4 || cnf->prod_num < 0 || cnf->prod_num > 99999)
+        return -1;
+
+    for (int i = 0; i < 4; i++)
+        if (!isupper((unsigned char)cnf->prod_code[i]))
+            return -1;
+
+    return 1;
+}
@@ -0,0 +1,54 @@
+/*
+ * SYSTEM.CNF parser fuzz harness
+ * ------------------------------
+ *
+ * libFuzzer entry point checking the parser invariants of cnf_check.h,
+ * seeded with the corpus in tests/cnf (make fuzz, needs clang):
+ *     ./tests/cnf_fuzz -max_len=4096 tests/cnf
+ *
+ * Built without libFuzzer (FUZZ_LIBFUZZER not defined), it replays the
+ * files given on the command line, eg crashes found by the fuzzer.
+ *
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "cnf_check.h"
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    ps2m_system_cnf_t cnf;
+
+    if (cnf_check((const char *)data, size, &cnf) < 0)
+        abort();
+
+    return 0;
+}
+
+#ifndef FUZZ_LIBFUZZER
+int main(int argc, char **argv)
+{
+    static uint8_t buf[1 << 16];
+
+    for (int i = 1; i < argc; i++)
+    {
+        FILE *fp = fopen(argv[i], "rb");
+        size_t len;
+
+        if (!fp) {
+            printf("[!] Failed to open '%s'\n", argv[i]);
+            return 1;
+        }
+
+        len = fread(buf, 1, sizeof(buf), fp);
+        fclose(fp);
+
+        LLVMFuzzerTestOneInput(buf, len);
+        printf("    + %s OK\n", argv[i]);
+    }
+
+    return 0;
+}
+#endif
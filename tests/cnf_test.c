@@ -0,0 +1,149 @@
+/*
+ * SYSTEM.CNF parser test
+ * ----------------------
+ *
+ * Every file of the corpus (tests/cnf) is parsed and checked against its
+ * expected Disc ID and video mode, then mutated copies of the corpus files
+ * (byte changes, separators, null bytes, truncation) are run through the
+ * parser invariants of cnf_check.h.
+ *
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "cnf_check.h"
+
+#define CNF_CORPUS_DIR      "tests/cnf/"
+#define CNF_MAX_SIZE        4096
+#define CNF_MUTATIONS       20000       // mutated inputs per corpus file
+
+typedef struct {
+    const char *name;
+    bool ok;                    // valid BOOT2 line
+    const char *prod_code;
+    int prod_num;
+    int pal;
+} cnf_expect_t;
+
+static const cnf_expect_t cnf_corpus[] = {
+    { "sles_50123_pal.cnf",         true,  "SLES", 50123, 1 },
+    { "slus_20946_hdd.cnf",         true,  "SLUS", 20946, 0 },
+    { "scps_15023_subdir.cnf",      true,  "SCPS", 15023, 0 },
+    { "slus_21234_lower.cnf",       true,  "SLUS", 21234, 0 },
+    { "sces_12345_nospace.cnf",     true,  "SCES", 12345, 1 },
+    { "sles_52889_reordered.cnf",   true,  "SLES", 52889, 1 },
+    { "slpm_65432_padded.cnf",      true,  "SLPM", 65432, 0 },
+    { "long_values.cnf",            true,  "SLES", 50123, 1 },
+    { "nul_stops.cnf",              true,  "SLES", 50123, 0 },
+    { "bad_truncated.cnf",          false, "",    -1, 0 },
+    { "bad_short_number.cnf",       false, "",    -1, 0 },
+    { "bad_host_device.cnf",        false, "",    -1, 0 },
+    { "bad_ps1_boot.cnf",           false, "",    -1, 0 },
+    { "bad_long_path.cnf",          false, "",    -1, 0 },
+    { "bad_empty.cnf",              false, "",    -1, 0 },
+    { "bad_binary.cnf",             false, "",    -1, 0 },
+};
+
+static uint64_t test_seed = 0x9E3779B97F4A7C15ULL;
+
+// xorshift64: the same mutations on every run
+static uint32_t test_rand(void)
+{
+    test_seed ^= test_seed << 13;
+    test_seed ^= test_seed >> 7;
+    test_seed ^= test_seed << 17;
+    return test_seed >> 32;
+}
+
+static size_t load_file(const char *name, char *buf, size_t size)
+{
+    char path[256];
+    size_t len;
+    FILE *fp;
+
+    snprintf(path, sizeof(path), CNF_CORPUS_DIR "%s", name);
+    if (!(fp = fopen(path, "rb")))
+        return SIZE_MAX;
+
+    len = fread(buf, 1, size, fp);
+    fclose(fp);
+    return len;
+}
+
+// Mutates a copy of a corpus file, biased towards the bytes the tokenizer looks at
+static size_t mutate(char *dst, const char *src, size_t len)
+{
+    static const char special[] = "=\r\n\t \\/;:._0PAL";
+    int edits = 1 + test_rand() % 8;
+
+    memcpy(dst, src, len);
+    for (int i = 0; i < edits && len; i++)
+    {
+        size_t pos = test_rand() % len;
+
+        switch (test_rand() % 4)
+        {
+        case 0:
+            dst[pos] = test_rand();
+            break;
+        case 1:
+            dst[pos] = special[test_rand() % (sizeof(special) - 1)];
+            break;
+        case 2:
+            dst[pos] = 0;
+            break;
+        case 3:
+            len = pos;
+            break;
+        }
+    }
+
+    return len;
+}
+
+int main(void)
+{
+    static char data[CNF_MAX_SIZE], buf[CNF_MAX_SIZE];
+    ps2m_system_cnf_t cnf;
+    int failed = 0;
+
+    printf("[i] SYSTEM.CNF parser\n");
+
+    for (size_t n = 0; n < sizeof(cnf_corpus) / sizeof(cnf_corpus[0]); n++)
+    {
+        const cnf_expect_t *e = &cnf_corpus[n];
+        size_t len = load_file(e->name, data, sizeof(data));
+        int ret;
+
+        if (len == SIZE_MAX) {
+            printf("[!] cnf: can't read '%s'\n", e->name);
+            failed = 1;
+            continue;
+        }
+
+        ret = cnf_check(data, len, &cnf);
+        if (ret < 0 || ret != e->ok || strcmp(cnf.prod_code, e->prod_code) != 0 || cnf.prod_num != e->prod_num || cnf.pal != e->pal) {
+            printf("[!] cnf: '%s' parsed as %s-%d (%s)\n", e->name, cnf.prod_code, cnf.prod_num, cnf.pal ? "PAL" : "NTSC");
+            failed = 1;
+            continue;
+        }
+
+        for (int i = 0; i < CNF_MUTATIONS; i++)
+        {
+            size_t size = mutate(buf, data, len);
+
+            if (cnf_check(buf, size, &cnf) < 0) {
+                printf("[!] cnf: invariant broken by a mutation of '%s' (%zu bytes)\n", e->name, size);
+                failed = 1;
+                break;
+            }
+        }
+    }
+
+    if (!failed)
+        printf("    + %-9s OK (%zu files, %d mutations each)\n", "corpus", sizeof(cnf_corpus) / sizeof(cnf_corpus[0]), CNF_MUTATIONS);
+
+    return failed;
+}
@@ -0,0 +1,127 @@
+/*
+ * CRC-32 differential test
+ * ------------------------
+ *
+ * The slice-by-16 and PCLMULQDQ kernels (when the CPU supports it) and the
+ * streaming API are checked against the original bit-serial crc32b loop on
+ * random buffers of random length and alignment, plus known check values.
+ *
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "crc32.h"
+
+#define TEST_BUFFERS        3000
+#define TEST_MAX_SIZE       70000
+#define TEST_LOGO_SIZE      (12 * 2048)
+
+static uint64_t test_seed = 0x9E3779B97F4A7C15ULL;
+
+// xorshift64: the same buffers on every run
+static uint32_t test_rand(void)
+{
+    test_seed ^= test_seed << 13;
+    test_seed ^= test_seed >> 7;
+    test_seed ^= test_seed << 17;
+    return test_seed >> 32;
+}
+
+// Reference: the bit-serial crc32b routine the kernels replaced
+static uint32_t crc32b(const uint8_t *data, size_t size)
+{
+    uint32_t crc = 0xFFFFFFFF;
+
+    for (size_t i = 0; i < size; i++)
+    {
+        crc ^= data[i];
+        for (int j = 7; j >= 0; j--)
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+
+    return ~crc;
+}
+
+static int test_kernel(const char *name, crc32_kernel_t kernel)
+{
+    static uint8_t buf[TEST_MAX_SIZE + 16];
+
+    for (int n = 0; n < TEST_BUFFERS; n++)
+    {
+        // short buffers hit the head/tail paths, long ones the folding loop
+        size_t size = (n & 1) ? test_rand() % 256 : test_rand() % TEST_MAX_SIZE;
+        uint8_t *data = buf + test_rand() % 16;
+
+        for (size_t i = 0; i < size; i++)
+            data[i] = test_rand();
+
+        if (~kernel(0xFFFFFFFF, data, size) != crc32b(data, size)) {
+            printf("[!] crc32: %s differs from crc32b on a %zu-byte buffer\n", name, size);
+            return 1;
+        }
+    }
+
+    printf("    + %-9s OK (%d buffers)\n", name, TEST_BUFFERS);
+    return 0;
+}
+
+// The streaming API must not depend on how the data is split
+static int test_stream(void)
+{
+    static uint8_t buf[TEST_MAX_SIZE];
+
+    for (int n = 0; n < TEST_BUFFERS / 10; n++)
+    {
+        size_t size = test_rand() % TEST_MAX_SIZE, done = 0;
+        crc32_ctx ctx;
+
+        for (size_t i = 0; i < size; i++)
+            buf[i] = test_rand();
+
+        crc32_init(&ctx);
+        while (done < size)
+        {
+            size_t len = test_rand() % 4096;
+
+            if (len > size - done)
+                len = size - done;
+
+            crc32_update(&ctx, buf + done, len);
+            done += len;
+        }
+
+        if (crc32_final(&ctx) != crc32b(buf, size)) {
+            printf("[!] crc32: streaming differs from crc32b on a %zu-byte buffer\n", size);
+            return 1;
+        }
+    }
+
+    printf("    + %-9s OK (%d buffers)\n", "stream", TEST_BUFFERS / 10);
+    return 0;
+}
+
+int main(void)
+{
+    static const uint8_t empty_logo[TEST_LOGO_SIZE];
+    int failed = 0;
+
+    printf("[i] CRC-32 kernels\n");
+
+    // builds the tables
+    if (crc32_calc("123456789", 9) != 0xCBF43926 || crc32_calc(empty_logo, sizeof(empty_logo)) != 0x6EBED2EE) {
+        printf("[!] crc32: wrong check values\n");
+        failed = 1;
+    }
+
+    failed |= test_kernel("bytewise", crc32_bytewise);
+    failed |= test_kernel("slice16", crc32_slice16);
+#ifdef CRC32_HAVE_CLMUL
+    if (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1"))
+        failed |= test_kernel("clmul", crc32_clmul);
+#endif
+    failed |= test_stream();
+
+    return failed;
+}
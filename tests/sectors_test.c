@@ -0,0 +1,184 @@
+/*
+ * Raw sector batch differential test
+ * ----------------------------------
+ *
+ * ps2m_raw_sectors_fix / ps2m_raw_sectors_check are checked sector by sector
+ * against a scalar reference (EDCTable byte loop and ecc_pq_scalar) and
+ * ps2m_sector_check on runs of random Mode 1, Mode 2 Form 1 / Form 2 and
+ * non-data sectors, with damaged sync, EDC, parity and header bytes, and run
+ * lengths that aren't a multiple of the library batch size.
+ *
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "cdrom.h"
+#include "edc.h"
+#include "ecc.h"
+#include "libps2master.h"
+
+#define TEST_RUNS           300
+#define TEST_MAX_SECTORS    37
+
+#define MODE1_EDC_OFFSET    (HEADER_OFFSET + HEADER_SIZE + 2048)
+
+static const uint8_t test_sync[SYNC_SIZE] = {0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00};
+
+static uint64_t test_seed = 0x9E3779B97F4A7C15ULL;
+
+// xorshift64: the same sectors on every run
+static uint32_t test_rand(void)
+{
+    test_seed ^= test_seed << 13;
+    test_seed ^= test_seed >> 7;
+    test_seed ^= test_seed << 17;
+    return test_seed >> 32;
+}
+
+// Random sector of a random type: Mode 1, Form 1, Form 2 (with or without EDC) or audio
+static int test_sector(uint8_t *sector, uint32_t lba)
+{
+    int type = test_rand() % 5;
+
+    for (int i = 0; i < SECTOR_SIZE; i++)
+        sector[i] = test_rand();
+
+    if (type == 4)
+        return PS2M_MODE_NONE;
+
+    memcpy(sector, test_sync, SYNC_SIZE);
+    ps2m_lba_to_msf(lba, sector + HEADER_OFFSET);
+    sector[HEADER_OFFSET + 3] = (type == 0) ? MODE_1 : MODE_2;
+
+    if (type == 0)
+        return PS2M_MODE1;
+
+    sector[CDROMXA_SUBHEADER_OFFSET + 2] = (type == 1) ? 0x08 : 0x20;
+    memcpy(sector + CDROMXA_SUBHEADER_OFFSET + 4, sector + CDROMXA_SUBHEADER_OFFSET, 4);
+    if (type == 3)
+        edc_store(sector + CDROMXA_FORM2_EDC_OFFSET, 0);
+
+    return (type == 1) ? PS2M_MODE2_FORM1 : PS2M_MODE2_FORM2;
+}
+
+// Reference: the scalar fixMode2Form1Sector steps for every sector type
+static void fix_ref(uint8_t *sector, int type)
+{
+    uint8_t header[HEADER_SIZE];
+
+    memcpy(sector, test_sync, SYNC_SIZE);
+
+    switch (type)
+    {
+    case PS2M_MODE1:
+        edc_store(sector + MODE1_EDC_OFFSET, edc_bytewise(0, sector, MODE1_EDC_OFFSET));
+        memset(sector + MODE1_EDC_OFFSET + EDC_SIZE, 0, 8);
+        ecc_pq_scalar(sector);
+        break;
+
+    case PS2M_MODE2_FORM1:
+        edc_store(sector + CDROMXA_FORM1_EDC_OFFSET, edc_bytewise(0, sector + CDROMXA_SUBHEADER_OFFSET, CDROMXA_FORM1_EDC_OFFSET - CDROMXA_SUBHEADER_OFFSET));
+        memcpy(header, sector + HEADER_OFFSET, HEADER_SIZE);
+        memset(sector + HEADER_OFFSET, 0, HEADER_SIZE);
+        ecc_pq_scalar(sector);
+        memcpy(sector + HEADER_OFFSET, header, HEADER_SIZE);
+        break;
+
+    case PS2M_MODE2_FORM2:
+        if (edc_load(sector + CDROMXA_FORM2_EDC_OFFSET) != 0)
+            edc_store(sector + CDROMXA_FORM2_EDC_OFFSET, edc_bytewise(0, sector + CDROMXA_SUBHEADER_OFFSET, CDROMXA_FORM2_EDC_OFFSET - CDROMXA_SUBHEADER_OFFSET));
+        break;
+    }
+}
+
+// Damages a few bytes of a fixed sector (sync, EDC/parity area or anywhere)
+static void damage(uint8_t *sector)
+{
+    int edits = test_rand() % 4;
+
+    for (int i = 0; i < edits; i++)
+    {
+        switch (test_rand() % 3)
+        {
+        case 0:
+            sector[test_rand() % SYNC_SIZE] ^= 1 << (test_rand() % 8);
+            break;
+        case 1:
+            sector[CDROMXA_FORM1_EDC_OFFSET + test_rand() % (SECTOR_SIZE - CDROMXA_FORM1_EDC_OFFSET)] ^= 1 + test_rand() % 255;
+            break;
+        case 2:
+            sector[test_rand() % SECTOR_SIZE] ^= 1 + test_rand() % 255;
+            break;
+        }
+    }
+}
+
+int main(void)
+{
+    static uint8_t sectors[TEST_MAX_SECTORS * SECTOR_SIZE], ref[TEST_MAX_SECTORS * SECTOR_SIZE];
+    static int flags[TEST_MAX_SECTORS];
+    int total = 0;
+
+    printf("[i] Raw sector batches\n");
+
+    for (int run = 0; run < TEST_RUNS; run++)
+    {
+        uint32_t count = 1 + test_rand() % TEST_MAX_SECTORS;
+        uint32_t lba = test_rand() % 300000;
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            uint8_t *sector = sectors + (size_t)i * SECTOR_SIZE;
+            int type = test_sector(sector, lba + i);
+
+            fix_ref(sector, type);
+            damage(sector);
+        }
+        memcpy(ref, sectors, (size_t)count * SECTOR_SIZE);
+
+        // check: the per-sector flags
+        ps2m_raw_sectors_check(sectors, count, lba, flags);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            if (flags[i] != ps2m_sector_check(sectors + (size_t)i * SECTOR_SIZE, lba + i)) {
+                printf("[!] sectors: check flags %#x differ from ps2m_sector_check on sector %u of run %d\n", flags[i], i, run);
+                return 1;
+            }
+        }
+
+        // fix: the reference loop on data sectors, untouched non-data sectors
+        ps2m_raw_sectors_fix(sectors, count, lba, flags);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            uint8_t *sector = sectors + (size_t)i * SECTOR_SIZE, *expect = ref + (size_t)i * SECTOR_SIZE;
+            int type = ps2m_sector_type(expect, lba + i);
+            uint8_t orig[SECTOR_SIZE];
+            int want = PS2M_SECTOR_SKIPPED;
+
+            if (type != PS2M_MODE_NONE)
+            {
+                memcpy(orig, expect, SECTOR_SIZE);
+                fix_ref(expect, type);
+                want = (type == PS2M_MODE1) ? PS2M_SECTOR_MODE1 : (type == PS2M_MODE2_FORM2) ? PS2M_SECTOR_FORM2 : 0;
+                if (memcmp(orig, expect, SECTOR_SIZE) != 0)
+                    want |= PS2M_SECTOR_FIXED;
+            }
+
+            if (memcmp(sector, expect, SECTOR_SIZE) != 0 || flags[i] != want) {
+                printf("[!] sectors: fix differs from the scalar reference on sector %u of run %d\n", i, run);
+                return 1;
+            }
+            if (type != PS2M_MODE_NONE && (ps2m_sector_check(sector, lba + i) & ~(PS2M_SECTOR_MODE1 | PS2M_SECTOR_FORM2 | PS2M_SECTOR_BAD_SUBHEADER)) != 0) {
+                printf("[!] sectors: fixed sector %u of run %d doesn't check\n", i, run);
+                return 1;
+            }
+        }
+
+        total += count;
+    }
+
+    printf("    + %-9s OK (%d runs, %d sectors)\n", "fix/check", TEST_RUNS, total);
+    return 0;
+}